@@ -0,0 +1,715 @@
+/*
+  ==============================================================================
+
+    BiquadCascade.h
+    Fused processing of every active biquad section of the EQ in one pass.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+#include "SIMDLanes.h"
+
+//Plain biquad coefficients (normalised so that a0 == 1), cheap to copy from one thread to another.
+//Kept in double so that the double precision kernels get unquantised coefficients.
+struct BiquadCoefficients
+{
+    double b0 { 1.0 }, b1 { 0.0 }, b2 { 0.0 }, a1 { 0.0 }, a2 { 0.0 };
+};
+
+//Lets the cascade kernels run on plain samples as well as on juce::dsp::SIMDRegisters
+template<typename SampleType>
+struct CascadeSample
+{
+    static SampleType expand(double v) { return static_cast<SampleType>(v); }
+    static SampleType snapToZero(SampleType v) { return juce::dsp::util::snapToZero(v); }
+};
+
+template<typename ElementType>
+struct CascadeSample<juce::dsp::SIMDRegister<ElementType>>
+{
+    using Register = juce::dsp::SIMDRegister<ElementType>;
+    
+    static Register expand(double v) { return Register::expand(static_cast<ElementType>(v)); }
+    
+    //Denormals in the vectorised state are taken care of by juce::ScopedNoDenormals
+    static Register snapToZero(Register v) { return v; }
+};
+
+/**
+    A serial cascade of up to maxSections transposed direct form II biquads.
+    The cascade only holds the coefficients, the filter state lives in a State object
+    per channel (or per group of channels) so several channels can share one cascade.
+
+    Instead of walking the block once per filter (and testing a bypass flag per filter),
+    every active section is run back to back on each sample in a single pass. For the
+    duration of the block the coefficients and state of the active sections live in local
+    arrays sized at compile time, so the compiler can keep all of them in registers.
+
+    Steep slopes are dominated by the latency of the serial recursion, so on SSE/NEON
+    (and AVX2 when enabled) the cascade is pipelined instead as soon as one of the bands
+    flagged with setBandPipelined() (a cut of 24dB/Oct or more) is active : each section
+    gets a SIMD lane, lane k working on sample n - k while lane 0 takes sample n. One vector
+    step per sample then advances the whole cascade. Without such a band (12dB/Oct cuts,
+    the peak alone), or on blocks too short to fill and drain the pipeline, the scalar
+    kernel runs.
+
+    Sections can be flagged as high precision (very low cutoffs, where float coefficients
+    and state are too coarse). The active sections are then split into runs of the same
+    precision, kept in cascade order, and the caller runs the high precision ones on double
+    samples, see MultiChannelCascade.
+ */
+struct BiquadCascade
+{
+    static constexpr int maxSections = 9;
+
+    struct Section
+    {
+        BiquadCoefficients coefficients;
+    };
+    
+    template<typename SampleType>
+    struct State
+    {
+        State() { reset(); }
+        
+        void reset()
+        {
+            s1.fill(CascadeSample<SampleType>::expand(0.0));
+            s2.fill(CascadeSample<SampleType>::expand(0.0));
+        }
+        
+        std::array<SampleType, maxSections> s1, s2;
+    };
+
+    Section& getSection(int index) { return sections[(size_t)index]; }
+
+    void setSectionBypassed(int index, bool shouldBeBypassed)
+    {
+        if ( sectionBypassed[(size_t)index] != shouldBeBypassed )
+        {
+            sectionBypassed[(size_t)index] = shouldBeBypassed;
+            activeListNeedsUpdate = true;
+        }
+    }
+
+    bool isSectionBypassed(int index) const { return sectionBypassed[(size_t)index]; }
+
+    //The numSections sections from firstSection on make the cascade worth pipelining while active
+    void setBandPipelined(int firstSection, int numSections, bool shouldBePipelined)
+    {
+        for ( int i = firstSection; i < firstSection + numSections; ++i )
+        {
+            if ( sectionPipelined[(size_t)i] != shouldBePipelined )
+            {
+                sectionPipelined[(size_t)i] = shouldBePipelined;
+                activeListNeedsUpdate = true;
+            }
+        }
+    }
+
+    void setSectionHighPrecision(int index, bool shouldUseHighPrecision)
+    {
+        if ( sectionHighPrecision[(size_t)index] != shouldUseHighPrecision )
+        {
+            sectionHighPrecision[(size_t)index] = shouldUseHighPrecision;
+            precisionChanges |= 1 << index;
+            activeListNeedsUpdate = true;
+        }
+    }
+
+    bool isSectionHighPrecision(int index) const { return sectionHighPrecision[(size_t)index]; }
+
+    bool hasActiveHighPrecisionSections()
+    {
+        if ( activeListNeedsUpdate )
+            updateActiveList();
+
+        return numHighPrecisionRuns > 0;
+    }
+
+    //Consecutive active sections sharing the same precision, in cascade order
+    int getNumPrecisionRuns()
+    {
+        if ( activeListNeedsUpdate )
+            updateActiveList();
+
+        return numPrecisionRuns;
+    }
+
+    bool isPrecisionRunHigh(int run) const { return precisionRuns[(size_t)run].highPrecision; }
+
+    //Bit i is set when section i changed precision since the last call, so the caller can move its state over
+    int takePrecisionChanges()
+    {
+        auto changes = precisionChanges;
+        precisionChanges = 0;
+        return changes;
+    }
+
+    static constexpr int allRuns = -1;
+
+    //Runs every active section, or only those of one precision run
+    template<typename SampleType>
+    void process(SampleType* data, int numSamples, State<SampleType>& state, int run = allRuns)
+    {
+        if ( activeListNeedsUpdate )
+            updateActiveList();
+
+        const auto& list = run == allRuns ? activeSections : precisionRuns[(size_t)run];
+        const int* indices = list.indices.data();
+        const int numActiveSections = list.numSections;
+
+       #if ZOOEQ_SIMD
+        //A single float channel with a steep band goes through one pipelined pass, as long
+        //as the block is long enough for the extra filling and draining steps not to matter
+        if constexpr ( std::is_same_v<SampleType, float> )
+        {
+           #if ZOOEQ_SIMD_AVX2
+            using Lanes = SIMDLanes8;
+           #else
+            using Lanes = SIMDLanes4;
+           #endif
+
+            const auto worthPipelining = list.numPipelined > 0 && numSamples >= minPipelinedBlockSize;
+
+            switch ( worthPipelining ? numActiveSections : 0 )
+            {
+                case 2: processPipelined<Lanes, 2>(indices, data, numSamples, state); return;
+                case 3: processPipelined<Lanes, 3>(indices, data, numSamples, state); return;
+                case 4: processPipelined<Lanes, 4>(indices, data, numSamples, state); return;
+                case 5: processPipelined<Lanes, 5>(indices, data, numSamples, state); return;
+                case 6: processPipelined<Lanes, 6>(indices, data, numSamples, state); return;
+                case 7: processPipelined<Lanes, 7>(indices, data, numSamples, state); return;
+                case 8: processPipelined<Lanes, 8>(indices, data, numSamples, state); return;
+                case 9: processPipelined<Lanes, 9>(indices, data, numSamples, state); return;
+                default: break;
+            }
+        }
+       #endif
+
+        switch ( numActiveSections )
+        {
+            case 0: break;
+            case 1: processActiveSections<1>(indices, data, numSamples, state); break;
+            case 2: processActiveSections<2>(indices, data, numSamples, state); break;
+            case 3: processActiveSections<3>(indices, data, numSamples, state); break;
+            case 4: processActiveSections<4>(indices, data, numSamples, state); break;
+            case 5: processActiveSections<5>(indices, data, numSamples, state); break;
+            case 6: processActiveSections<6>(indices, data, numSamples, state); break;
+            case 7: processActiveSections<7>(indices, data, numSamples, state); break;
+            case 8: processActiveSections<8>(indices, data, numSamples, state); break;
+            case 9: processActiveSections<9>(indices, data, numSamples, state); break;
+            default: jassertfalse; break;
+        }
+    }
+
+private:
+    //Filling and draining the pipeline takes numSections - 1 masked steps per block, which
+    //shorter blocks do not make up for
+    static constexpr int minPipelinedBlockSize = 32;
+
+    std::array<Section, maxSections> sections;
+    std::array<bool, maxSections> sectionBypassed { true, true, true, true, true, true, true, true, true };
+    std::array<bool, maxSections> sectionHighPrecision {};
+    std::array<bool, maxSections> sectionPipelined {};
+    int precisionChanges = 0;
+
+    struct SectionList
+    {
+        std::array<int, maxSections> indices {};
+        int numSections = 0;
+        //Active sections of a band flagged with setBandPipelined()
+        int numPipelined = 0;
+        bool highPrecision = false;
+
+        void add(int index, bool pipelined)
+        {
+            indices[(size_t)numSections++] = index;
+            numPipelined += pipelined ? 1 : 0;
+        }
+    };
+
+    SectionList activeSections;
+    std::array<SectionList, maxSections> precisionRuns;
+    int numPrecisionRuns = 0, numHighPrecisionRuns = 0;
+    bool activeListNeedsUpdate = true;
+
+    void updateActiveList()
+    {
+        activeSections.numSections = activeSections.numPipelined = 0;
+        numPrecisionRuns = numHighPrecisionRuns = 0;
+
+        for ( int i = 0; i < maxSections; ++i )
+        {
+            if ( sectionBypassed[(size_t)i] )
+                continue;
+
+            auto pipelined = sectionPipelined[(size_t)i];
+            auto highPrecision = sectionHighPrecision[(size_t)i];
+            activeSections.add(i, pipelined);
+
+            //A section of the other precision starts a new run
+            if ( numPrecisionRuns == 0 || precisionRuns[(size_t)numPrecisionRuns - 1].highPrecision != highPrecision )
+            {
+                auto& run = precisionRuns[(size_t)numPrecisionRuns++];
+                run.numSections = run.numPipelined = 0;
+                run.highPrecision = highPrecision;
+                numHighPrecisionRuns += highPrecision ? 1 : 0;
+            }
+
+            precisionRuns[(size_t)numPrecisionRuns - 1].add(i, pipelined);
+        }
+
+        activeListNeedsUpdate = false;
+    }
+
+    template<int NumSections, typename SampleType>
+    void processActiveSections(const int* indices, SampleType* data, int numSamples, State<SampleType>& state)
+    {
+        using Sample = CascadeSample<SampleType>;
+        
+        SampleType b0[NumSections], b1[NumSections], b2[NumSections], a1[NumSections], a2[NumSections];
+        SampleType s1[NumSections], s2[NumSections];
+
+        for ( int k = 0; k < NumSections; ++k )
+        {
+            auto index = (size_t)indices[k];
+            const auto& c = sections[index].coefficients;
+
+            b0[k] = Sample::expand(c.b0); b1[k] = Sample::expand(c.b1); b2[k] = Sample::expand(c.b2);
+            a1[k] = Sample::expand(c.a1); a2[k] = Sample::expand(c.a2);
+            s1[k] = state.s1[index]; s2[k] = state.s2[index];
+        }
+
+        for ( int i = 0; i < numSamples; ++i )
+        {
+            auto x = data[i];
+
+            //Same recursion as juce::dsp::IIR::Filter for a second order section
+            for ( int k = 0; k < NumSections; ++k )
+            {
+                auto y = b0[k] * x + s1[k];
+                s1[k] = b1[k] * x - a1[k] * y + s2[k];
+                s2[k] = b2[k] * x - a2[k] * y;
+                x = y;
+            }
+
+            data[i] = x;
+        }
+
+        for ( int k = 0; k < NumSections; ++k )
+        {
+            auto index = (size_t)indices[k];
+            state.s1[index] = Sample::snapToZero(s1[k]);
+            state.s2[index] = Sample::snapToZero(s2[k]);
+        }
+    }
+
+   #if ZOOEQ_SIMD
+    /**
+        Wavefront over NumSections consecutive sections, one section per lane spread over
+        as many registers as needed (the spare lanes of the last one are left out). At step
+        t the section in lane g filters sample t - g, its input being what lane g - 1 produced
+        on the previous step, so the lane of the last section hands out sample t - depth.
+        During the first and last depth steps only the lanes holding a real sample may update
+        their state, which keeps the result identical to running the sections one after the
+        other, without adding any latency.
+     */
+    template<typename Lanes, int NumSections, typename SampleType>
+    void processPipelined(const int* indices, SampleType* data, int numSamples, State<SampleType>& state)
+    {
+        static_assert(std::is_same_v<SampleType, float>, "The pipelined kernel only works on single channel floats");
+
+        using Reg = typename Lanes::Reg;
+        constexpr int numLanes = Lanes::numLanes;
+        constexpr int NumRegs = (NumSections + numLanes - 1) / numLanes;
+        constexpr int numSlots = NumRegs * numLanes;
+        constexpr int depth = NumSections - 1;
+
+        alignas(32) float b0[numSlots], b1[numSlots], b2[numSlots], a1[numSlots], a2[numSlots];
+        alignas(32) float s1[numSlots], s2[numSlots];
+
+        for ( int k = 0; k < numSlots; ++k )
+        {
+            BiquadCoefficients c;
+            s1[k] = s2[k] = 0.f;
+
+            if ( k < NumSections )
+            {
+                auto index = (size_t)indices[k];
+                c = sections[index].coefficients;
+                s1[k] = state.s1[index];
+                s2[k] = state.s2[index];
+            }
+
+            b0[k] = (float)c.b0; b1[k] = (float)c.b1; b2[k] = (float)c.b2; a1[k] = (float)c.a1; a2[k] = (float)c.a2;
+        }
+
+        Reg vb0[NumRegs], vb1[NumRegs], vb2[NumRegs], va1[NumRegs], va2[NumRegs];
+        Reg vs1[NumRegs], vs2[NumRegs], previous[NumRegs];
+
+        for ( int r = 0; r < NumRegs; ++r )
+        {
+            auto offset = r * numLanes;
+            vb0[r] = Lanes::load(b0 + offset); vb1[r] = Lanes::load(b1 + offset); vb2[r] = Lanes::load(b2 + offset);
+            va1[r] = Lanes::load(a1 + offset); va2[r] = Lanes::load(a2 + offset);
+            vs1[r] = Lanes::load(s1 + offset); vs2[r] = Lanes::load(s2 + offset);
+            previous[r] = Lanes::expand(0.f);
+        }
+
+        auto step = [&](float x)
+        {
+            Reg in[NumRegs];
+            in[0] = Lanes::shiftIn(previous[0], x);
+
+            for ( int r = 1; r < NumRegs; ++r )
+                in[r] = Lanes::shiftIn(previous[r], Lanes::lastLane(previous[r - 1]));
+
+            for ( int r = 0; r < NumRegs; ++r )
+            {
+                auto out = Lanes::add(Lanes::mul(vb0[r], in[r]), vs1[r]);
+                vs1[r] = Lanes::add(Lanes::sub(Lanes::mul(vb1[r], in[r]), Lanes::mul(va1[r], out)), vs2[r]);
+                vs2[r] = Lanes::sub(Lanes::mul(vb2[r], in[r]), Lanes::mul(va2[r], out));
+                previous[r] = out;
+            }
+
+            return Lanes::template getLane<depth % numLanes>(previous[NumRegs - 1]);
+        };
+
+        //Filling and draining the pipeline : lane g only holds a real sample when 0 <= t - g < numSamples
+        auto maskedStep = [&](int t)
+        {
+            Reg oldS1[NumRegs], oldS2[NumRegs];
+
+            for ( int r = 0; r < NumRegs; ++r )
+            {
+                oldS1[r] = vs1[r];
+                oldS2[r] = vs2[r];
+            }
+
+            auto y = step(t < numSamples ? data[t] : 0.f);
+
+            for ( int r = 0; r < NumRegs; ++r )
+            {
+                auto laneT = float(t - r * numLanes);
+                auto valid = Lanes::lanesBetween(laneT - float(numSamples), laneT);
+                vs1[r] = Lanes::select(valid, vs1[r], oldS1[r]);
+                vs2[r] = Lanes::select(valid, vs2[r], oldS2[r]);
+            }
+
+            if ( t >= depth )
+                data[t - depth] = y;
+        };
+
+        const int fillEnd = juce::jmin(depth, numSamples + depth);
+        const int drainStart = juce::jmax(depth, numSamples);
+
+        for ( int t = 0; t < fillEnd; ++t )
+            maskedStep(t);
+
+        for ( int t = depth; t < numSamples; ++t )
+            data[t - depth] = step(data[t]);
+
+        for ( int t = drainStart; t < numSamples + depth; ++t )
+            maskedStep(t);
+
+        for ( int r = 0; r < NumRegs; ++r )
+        {
+            Lanes::store(s1 + r * numLanes, vs1[r]);
+            Lanes::store(s2 + r * numLanes, vs2[r]);
+        }
+
+        for ( int k = 0; k < NumSections; ++k )
+        {
+            auto index = (size_t)indices[k];
+            state.s1[index] = juce::dsp::util::snapToZero(s1[k]);
+            state.s2[index] = juce::dsp::util::snapToZero(s2[k]);
+        }
+    }
+   #endif
+};
+
+/**
+    A run of NumSections consecutive sections of a BiquadCascade, seen through the same
+    get<Index>() / setBypassed<Index>() interface as a juce::dsp::ProcessorChain so that
+    updateCutFilter() can load a cut filter into it unchanged.
+ */
+template<int NumSections>
+struct CascadeBand
+{
+    CascadeBand(BiquadCascade& c, int first) : cascade(c), firstSection(first) {}
+
+    template<int Index>
+    BiquadCascade::Section& get()
+    {
+        static_assert(Index < NumSections, "Section out of the band");
+        return cascade.getSection(firstSection + Index);
+    }
+
+    template<int Index>
+    void setBypassed(bool shouldBeBypassed)
+    {
+        static_assert(Index < NumSections, "Section out of the band");
+        cascade.setSectionBypassed(firstSection + Index, shouldBeBypassed);
+    }
+
+private:
+    BiquadCascade& cascade;
+    int firstSection;
+};
+
+/**
+    Runs one BiquadCascade over every channel of a block, whatever the channel count.
+
+    Mono and stereo keep one state per channel and the single channel kernels (pipelined
+    across the sections when they are steep enough). From 3 channels on (surround,
+    ambisonics...) the coefficients being identical for every channel, the channels are
+    interleaved into juce::dsp::SIMDRegisters instead so that each vector step filters
+    SIMDRegister::size() channels at once.
+
+    Double blocks run every section in double. In float blocks, the runs of sections flagged
+    as high precision go through a double pass of their own, in their place in the cascade.
+ */
+struct MultiChannelCascade
+{
+    static constexpr int maxChannels = 16;
+    
+    BiquadCascade cascade;
+    
+    void prepare(int newNumChannels, int maximumBlockSize)
+    {
+        jassert(juce::isPositiveAndBelow(newNumChannels, maxChannels + 1));
+        
+        numChannels = newNumChannels;
+        vectorised = numChannels > 2;
+        
+        const auto bufferSize = (size_t)juce::jmax(1, maximumBlockSize);
+        
+        channelStates.clear();
+        groupStates.clear();
+        interleaved.clear();
+        
+        if ( vectorised )
+        {
+            groupStates.resize((size_t)((numChannels + lanes - 1) / lanes));
+            interleaved.resize(bufferSize);
+        }
+        else
+        {
+            channelStates.resize((size_t)numChannels);
+        }
+        
+        doubleStates.clear();
+        doubleStates.resize((size_t)numChannels);
+        precisionBuffer.resize(bufferSize);
+        
+        cascade.takePrecisionChanges();
+    }
+    
+    void reset()
+    {
+        for ( auto& s : channelStates )
+            s.reset();
+        
+        for ( auto& s : groupStates )
+            s.reset();
+        
+        for ( auto& s : doubleStates )
+            s.reset();
+    }
+    
+    void process(const juce::dsp::AudioBlock<double>& block)
+    {
+        const auto numSamples = (int)block.getNumSamples();
+        const auto numToProcess = juce::jmin(numChannels, (int)block.getNumChannels());
+        
+        //Every section already runs on doubleStates here, a precision change has nothing to move.
+        //A host doesn't switch between float and double processing without preparing again.
+        cascade.takePrecisionChanges();
+        
+        for ( int ch = 0; ch < numToProcess; ++ch )
+            cascade.process(block.getChannelPointer((size_t)ch), numSamples, doubleStates[(size_t)ch]);
+    }
+    
+    void process(const juce::dsp::AudioBlock<float>& block)
+    {
+        const auto numSamples = (int)block.getNumSamples();
+        const auto numToProcess = juce::jmin(numChannels, (int)block.getNumChannels());
+        
+        if ( auto changes = cascade.takePrecisionChanges() )
+            moveStates(changes);
+        
+        if ( ! cascade.hasActiveHighPrecisionSections() )
+        {
+            processStandardPrecisionSections(block, numToProcess, numSamples, BiquadCascade::allRuns);
+            return;
+        }
+        
+        for ( int run = 0; run < cascade.getNumPrecisionRuns(); ++run )
+        {
+            if ( cascade.isPrecisionRunHigh(run) )
+                processHighPrecisionSections(block, numToProcess, numSamples, run);
+            else
+                processStandardPrecisionSections(block, numToProcess, numSamples, run);
+        }
+    }
+    
+private:
+    using Register = juce::dsp::SIMDRegister<float>;
+    static constexpr int lanes = (int)Register::SIMDNumElements;
+    
+    int numChannels = 0;
+    bool vectorised = false;
+    
+    std::vector<BiquadCascade::State<float>> channelStates;
+    std::vector<BiquadCascade::State<Register>> groupStates;
+    std::vector<Register> interleaved;
+    
+    std::vector<BiquadCascade::State<double>> doubleStates;
+    std::vector<double> precisionBuffer;
+    
+    void processStandardPrecisionSections(const juce::dsp::AudioBlock<float>& block, int numToProcess, int numSamples, int run)
+    {
+        if ( ! vectorised )
+        {
+            for ( int ch = 0; ch < numToProcess; ++ch )
+                cascade.process(block.getChannelPointer((size_t)ch), numSamples, channelStates[(size_t)ch], run);
+            
+            return;
+        }
+        
+        //Host blocks bigger than announced are processed in chunks of the interleaving buffer
+        const auto chunkSize = (int)interleaved.size();
+        
+        for ( int start = 0; start < numSamples; start += chunkSize )
+        {
+            auto num = juce::jmin(chunkSize, numSamples - start);
+            
+            for ( int group = 0; group < (int)groupStates.size(); ++group )
+            {
+                auto firstChannel = group * lanes;
+                auto numInGroup = juce::jmin(lanes, numToProcess - firstChannel);
+                
+                if ( numInGroup <= 0 )
+                    break;
+                
+                interleave(block, firstChannel, numInGroup, start, num);
+                cascade.process(interleaved.data(), num, groupStates[(size_t)group], run);
+                deinterleave(block, firstChannel, numInGroup, start, num);
+            }
+        }
+    }
+    
+    void processHighPrecisionSections(const juce::dsp::AudioBlock<float>& block, int numToProcess, int numSamples, int run)
+    {
+        const auto chunkSize = (int)precisionBuffer.size();
+        auto* buffer = precisionBuffer.data();
+        
+        for ( int ch = 0; ch < numToProcess; ++ch )
+        {
+            auto* channel = block.getChannelPointer((size_t)ch);
+            
+            for ( int start = 0; start < numSamples; start += chunkSize )
+            {
+                auto num = juce::jmin(chunkSize, numSamples - start);
+                
+                for ( int i = 0; i < num; ++i )
+                    buffer[i] = (double)channel[start + i];
+                
+                cascade.process(buffer, num, doubleStates[(size_t)ch], run);
+                
+                for ( int i = 0; i < num; ++i )
+                    channel[start + i] = (float)buffer[i];
+            }
+        }
+    }
+    
+    //A section switching precision carries on from the state its other kernel left
+    void moveStates(int changes)
+    {
+        for ( size_t index = 0; index < (size_t)BiquadCascade::maxSections; ++index )
+        {
+            if ( (changes & (1 << index)) == 0 )
+                continue;
+            
+            const auto toDouble = cascade.isSectionHighPrecision((int)index);
+            
+            for ( int ch = 0; ch < numChannels; ++ch )
+            {
+                auto& d = doubleStates[(size_t)ch];
+                
+                if ( vectorised )
+                {
+                    auto& g = groupStates[(size_t)(ch / lanes)];
+                    auto lane = (size_t)(ch % lanes);
+                    
+                    if ( toDouble )
+                    {
+                        d.s1[index] = g.s1[index].get(lane);
+                        d.s2[index] = g.s2[index].get(lane);
+                    }
+                    else
+                    {
+                        g.s1[index].set(lane, (float)d.s1[index]);
+                        g.s2[index].set(lane, (float)d.s2[index]);
+                    }
+                }
+                else
+                {
+                    auto& f = channelStates[(size_t)ch];
+                    
+                    if ( toDouble )
+                    {
+                        d.s1[index] = f.s1[index];
+                        d.s2[index] = f.s2[index];
+                    }
+                    else
+                    {
+                        f.s1[index] = (float)d.s1[index];
+                        f.s2[index] = (float)d.s2[index];
+                    }
+                }
+            }
+        }
+    }
+    
+    void interleave(const juce::dsp::AudioBlock<float>& block, int firstChannel, int numInGroup, int start, int num)
+    {
+        auto* dest = reinterpret_cast<float*>(interleaved.data());
+        
+        for ( int lane = 0; lane < lanes; ++lane )
+        {
+            if ( lane < numInGroup )
+            {
+                auto* src = block.getChannelPointer((size_t)(firstChannel + lane)) + start;
+                
+                for ( int i = 0; i < num; ++i )
+                    dest[i * lanes + lane] = src[i];
+            }
+            else
+            {
+                //Unused lanes of the last group just filter silence
+                for ( int i = 0; i < num; ++i )
+                    dest[i * lanes + lane] = 0.f;
+            }
+        }
+    }
+    
+    void deinterleave(const juce::dsp::AudioBlock<float>& block, int firstChannel, int numInGroup, int start, int num)
+    {
+        auto* src = reinterpret_cast<const float*>(interleaved.data());
+        
+        for ( int lane = 0; lane < numInGroup; ++lane )
+        {
+            auto* dest = block.getChannelPointer((size_t)(firstChannel + lane)) + start;
+            
+            for ( int i = 0; i < num; ++i )
+                dest[i] = src[i * lanes + lane];
+        }
+    }
+};
@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    Fifo.h
+    Single producer / single consumer queue of preallocated objects.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <utility>
+
+/**
+    Counters telling how far a consumer fell behind its producer, safe to read from any thread.
+ */
+struct FifoStatistics
+{
+    juce::int64 numDropped = 0;     //Elements (or samples) that never reached the consumer
+    juce::int64 numStalls = 0;      //Times the producer found the queue full after having been able to write
+    int highWaterMark = 0;          //Most elements (or samples) ever waiting to be read
+
+    bool hasDropped() const { return numDropped > 0; }
+
+    //For the logs, e.g. "1200 dropped in 3 stalls, at most 32768 waiting"
+    juce::String toString() const
+    {
+        return juce::String(numDropped) + " dropped in " + juce::String(numStalls) + " stalls, at most "
+             + juce::String(highWaterMark) + " waiting";
+    }
+};
+
+struct FifoTelemetry
+{
+    //Producer side
+    void recordWrite(int numWritten, int numRequested, int numReadyAfterWrite)
+    {
+        if ( numWritten < numRequested )
+        {
+            numDropped.fetch_add(numRequested - numWritten, std::memory_order_relaxed);
+
+            //Only the first failure of a run counts as a stall
+            if ( ! stalled )
+                numStalls.fetch_add(1, std::memory_order_relaxed);
+
+            stalled = true;
+        }
+        else
+        {
+            stalled = false;
+        }
+
+        if ( numReadyAfterWrite > highWaterMark.load(std::memory_order_relaxed) )
+            highWaterMark.store(numReadyAfterWrite, std::memory_order_relaxed);
+    }
+
+    FifoStatistics get() const
+    {
+        return { numDropped.load(std::memory_order_relaxed),
+                 numStalls.load(std::memory_order_relaxed),
+                 highWaterMark.load(std::memory_order_relaxed) };
+    }
+
+    //Not thread safe : call it while the producer isn't running
+    void reset()
+    {
+        numDropped = 0;
+        numStalls = 0;
+        highWaterMark = 0;
+        stalled = false;
+    }
+
+private:
+    std::atomic<juce::int64> numDropped { 0 }, numStalls { 0 };
+    std::atomic<int> highWaterMark { 0 };
+    bool stalled = false;
+};
+
+/**
+    Capacity elements are allocated once, in prepare(). push() and pull() swap the
+    caller's object with a slot instead of copying it, so both sides hand back a
+    preallocated object of the same shape and nothing is allocated afterwards, as
+    long as the caller keeps reusing the object it got back.
+
+    Every element is delivered in order : when the queue is full push() refuses the new
+    one, which is counted as dropped. A consumer that only wants the most recent value
+    should use a TripleBuffer instead, which overwrites whatever wasn't read.
+ */
+template<typename T, int Capacity = 30>
+struct Fifo
+{
+    static_assert(Capacity > 0, "A Fifo needs room for at least one element");
+
+    void prepare(int numChannels, int numSamples)
+    {
+        static_assert(std::is_same_v<T, juce::AudioBuffer<float>>,
+                      "prepare(numChannels, numSamples) should only be use when the fifo is holding juce::AudioBuffer<float>");
+
+        for (auto& buffer : buffers)
+        {
+            buffer.setSize(numChannels,
+                           numSamples,
+                           false,       //clear everything ?
+                           true,        //including the extra space ?
+                           true);       //avoid reallocation if you can ?
+            buffer.clear();
+        }
+
+        reset();
+    }
+
+    void prepare(size_t numElements)
+    {
+        static_assert(std::is_same_v<T, std::vector<float>>,
+                      "prepare(numElements) should only be use when the fifo is holding std::vector<float>");
+
+        for ( auto& buffer : buffers )
+        {
+            buffer.clear();
+            buffer.resize(numElements, 0);
+        }
+
+        reset();
+    }
+
+    //Not thread safe : call it while neither side is running
+    void reset()
+    {
+        fifo.reset();
+        telemetry.reset();
+    }
+
+    // === Producer === //
+    //On success t is swapped with a free slot and holds that slot's previous contents
+    bool push(T& t)
+    {
+        bool written = false;
+
+        {
+            auto write = fifo.write(1);
+
+            if ( write.blockSize1 > 0 )
+            {
+                std::swap(buffers[(size_t)write.startIndex1], t);
+                written = true;
+            }
+        }
+
+        telemetry.recordWrite(written ? 1 : 0, 1, fifo.getNumReady());
+        return written;
+    }
+
+    // === Consumer === //
+    //On success t is swapped with the oldest element, its previous contents go back to the pool
+    bool pull(T& t)
+    {
+        auto read = fifo.read(1);
+
+        if ( read.blockSize1 > 0 )
+        {
+            std::swap(t, buffers[(size_t)read.startIndex1]);
+            return true;
+        }
+
+        return false;
+    }
+
+    int getNumAvailableForReading() const
+    {
+        return fifo.getNumReady();
+    }
+
+    static constexpr int getCapacity() { return Capacity; }
+
+    FifoStatistics getStatistics() const { return telemetry.get(); }
+
+private:
+    //The AbstractFifo keeps one slot free to tell full from empty
+    std::array<T, Capacity + 1> buffers;
+    juce::AbstractFifo fifo { Capacity + 1 };
+    FifoTelemetry telemetry;
+};
@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    LongTermSpectrum.h
+    Welch average of the power spectrum of a stereo signal, for any length of audio.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+#include "SpectrumMath.h"
+
+/**
+    Long-term average spectrum : 8192 point frames, Blackman-Harris windowed by the
+    analyser's own StereoSpectrumTransform, a hop of a quarter frame, and the power of
+    every bin summed in double. Memory stays the same however long it runs, and every
+    hop is used : nothing is skipped as in the display analysers.
+
+    The powers are relative to a full scale sine : a sine of amplitude 1 centred on a
+    bin averages to 1 (0 dB) in that bin.
+ */
+struct LongTermSpectrum
+{
+    static constexpr int numChannels = 2;
+    static constexpr int order = 13;
+    static constexpr int fftSize = 1 << order;
+    static constexpr int numBins = fftSize / 2;
+    static constexpr int hopSize = fftSize / 4;
+
+    //Allocates
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        transform.prepare(order);
+
+        for ( int ch = 0; ch < numChannels; ++ch )
+        {
+            windows[(size_t)ch].assign((size_t)fftSize, 0.f);
+            magnitudes[(size_t)ch].assign((size_t)numBins, 0.f);
+            powerSums[(size_t)ch].assign((size_t)numBins, 0.0);
+        }
+
+        reset();
+    }
+
+    //Starts a new average
+    void reset()
+    {
+        for ( auto& sums : powerSums )
+            std::fill(sums.begin(), sums.end(), 0.0);
+
+        writePosition = 0;
+        numFrames = 0;
+    }
+
+    //left and right hold numSamples samples each, taken at the same time
+    void push(const float* left, const float* right, int numSamples)
+    {
+        while ( numSamples > 0 )
+        {
+            auto numToCopy = juce::jmin(numSamples, fftSize - writePosition);
+
+            std::copy(left, left + numToCopy, windows[0].begin() + writePosition);
+            std::copy(right, right + numToCopy, windows[1].begin() + writePosition);
+
+            left += numToCopy;
+            right += numToCopy;
+            numSamples -= numToCopy;
+            writePosition += numToCopy;
+
+            if ( writePosition < fftSize )
+                break;
+
+            accumulateFrame();
+
+            //The next frame keeps the last fftSize - hopSize samples
+            for ( auto& window : windows )
+                std::copy(window.begin() + hopSize, window.end(), window.begin());
+
+            writePosition = fftSize - hopSize;
+        }
+    }
+
+    juce::int64 getNumFrames() const { return numFrames; }
+    double getSampleRate() const { return sampleRate; }
+
+    //Audio covered by the frames averaged so far
+    double getSecondsAnalysed() const
+    {
+        if ( numFrames == 0 || sampleRate <= 0 )
+            return 0;
+
+        return (double)((numFrames - 1) * hopSize + fftSize) / sampleRate;
+    }
+
+    double getMeanPower(int channel, int bin) const
+    {
+        return numFrames > 0 ? powerSums[(size_t)channel][(size_t)bin] / (double)numFrames : 0.0;
+    }
+
+    /**
+        Comment lines starting with '#' describe the capture, then one line per bin :
+        frequency (Hz), left (dB), right (dB). Empty bins are written as -300 dB.
+     */
+    void writeCSV(juce::OutputStream& out) const
+    {
+        out << "# ZooEQ long-term average spectrum\n"
+            << "# sample rate," << juce::String(sampleRate) << "\n"
+            << "# fft size," << fftSize << "\n"
+            << "# hop size," << hopSize << "\n"
+            << "# window,Blackman-Harris\n"
+            << "# frames," << juce::String(numFrames) << "\n"
+            << "# seconds," << juce::String(getSecondsAnalysed(), 3) << "\n"
+            << "frequency (Hz),left (dB),right (dB)\n";
+
+        const auto binWidth = sampleRate / (double)fftSize;
+
+        for ( int k = 0; k < numBins; ++k )
+        {
+            out << juce::String(k * binWidth, 3) << ","
+                << juce::String(toDecibels(getMeanPower(0, k)), 3) << ","
+                << juce::String(toDecibels(getMeanPower(1, k)), 3) << "\n";
+        }
+    }
+
+    /**
+        Little endian : the tag "ZLTS", int32 version (1), float64 sample rate, int32 fft
+        size, int32 hop size, int32 number of bins, int32 number of channels, int64 number
+        of frames, then the mean powers as float64, every bin of the left channel first.
+     */
+    void writeBinary(juce::OutputStream& out) const
+    {
+        out.write("ZLTS", 4);
+        out.writeInt(1);
+        out.writeDouble(sampleRate);
+        out.writeInt(fftSize);
+        out.writeInt(hopSize);
+        out.writeInt(numBins);
+        out.writeInt(numChannels);
+        out.writeInt64(numFrames);
+
+        for ( int ch = 0; ch < numChannels; ++ch )
+        {
+            for ( int k = 0; k < numBins; ++k )
+                out.writeDouble(getMeanPower(ch, k));
+        }
+    }
+
+private:
+    double sampleRate = 0;
+    StereoSpectrumTransform transform;
+
+    //The current frame, filled up to writePosition
+    std::array<std::vector<float>, numChannels> windows;
+    int writePosition = 0;
+
+    std::array<std::vector<float>, numChannels> magnitudes;
+    std::array<std::vector<double>, numChannels> powerSums;
+    juce::int64 numFrames = 0;
+
+    void accumulateFrame()
+    {
+        transform.perform(windows[0].data(), windows[1].data(), StereoView::leftRight, magnitudes[0].data(), magnitudes[1].data());
+
+        for ( int ch = 0; ch < numChannels; ++ch )
+        {
+            const auto* magnitude = magnitudes[(size_t)ch].data();
+            auto* sum = powerSums[(size_t)ch].data();
+
+            for ( int k = 0; k < numBins; ++k )
+                sum[k] += (double)magnitude[k] * (double)magnitude[k];
+        }
+
+        ++numFrames;
+    }
+
+    static double toDecibels(double power)
+    {
+        return power > 0 ? juce::jmax(-300.0, 10.0 * std::log10(power)) : -300.0;
+    }
+};
@@ -0,0 +1,292 @@
+/*
+  ==============================================================================
+
+    MultirateSpectrum.h
+    Octave band analyser : half-band decimation and one small FFT per octave.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+#include "SpectrumMath.h"
+
+/**
+    Decimation by two through a 55 tap half-band FIR, a Blackman windowed sinc. Every
+    other tap but the centre one is zero and the others come in symmetric pairs, so an
+    output sample costs 14 multiply-adds. Flat within 0.003 dB up to 0.2 fs and at least
+    70 dB down from 0.3 fs : nothing folds back below 0.4 of the output rate.
+ */
+struct HalfBandDecimator
+{
+    static constexpr int numTaps = 55;
+    static constexpr int centre = numTaps / 2;
+    static constexpr int numPairs = (centre + 1) / 2;
+
+    void reset()
+    {
+        history.fill(0);
+        writeIndex = 0;
+        oddSample = false;
+    }
+
+    //Returns the number of samples written to dest, at most (numSamples + 1) / 2
+    int process(const float* source, int numSamples, float* dest)
+    {
+        const auto& k = getCoefficients();
+        int numOut = 0;
+
+        for ( int i = 0; i < numSamples; ++i )
+        {
+            //Written twice : the last numTaps samples are always contiguous
+            history[(size_t)writeIndex] = history[(size_t)(writeIndex + numTaps)] = source[i];
+            writeIndex = writeIndex + 1 == numTaps ? 0 : writeIndex + 1;
+
+            oddSample = ! oddSample;
+
+            if ( oddSample )
+                continue;
+
+            //Oldest first
+            const auto* x = history.data() + writeIndex;
+            auto y = k.centreTap * x[centre];
+
+            for ( int p = 0; p < numPairs; ++p )
+                y += k.pairs[(size_t)p] * (x[centre - 2 * p - 1] + x[centre + 2 * p + 1]);
+
+            dest[numOut++] = y;
+        }
+
+        return numOut;
+    }
+
+private:
+    struct Coefficients
+    {
+        float centreTap = 0;
+        std::array<float, numPairs> pairs {};
+    };
+
+    static const Coefficients& getCoefficients()
+    {
+        static const Coefficients coefficients = []
+        {
+            const auto pi = juce::MathConstants<double>::pi;
+            std::array<double, numTaps> h {};
+            double sum = 0;
+
+            for ( int n = 0; n < numTaps; ++n )
+            {
+                auto m = n - centre;
+                auto sinc = m == 0 ? 0.5 : std::sin(pi * m / 2.0) / (pi * m);
+                auto window = 0.42 - 0.5 * std::cos(2.0 * pi * n / (numTaps - 1)) + 0.08 * std::cos(4.0 * pi * n / (numTaps - 1));
+
+                h[(size_t)n] = sinc * window;
+                sum += h[(size_t)n];
+            }
+
+            //Unity gain at DC
+            Coefficients c;
+            c.centreTap = (float)(h[(size_t)centre] / sum);
+
+            for ( int p = 0; p < numPairs; ++p )
+                c.pairs[(size_t)p] = (float)(h[(size_t)(centre + 2 * p + 1)] / sum);
+
+            return c;
+        }();
+
+        return coefficients;
+    }
+
+    std::array<float, 2 * numTaps> history {};
+    int writeIndex = 0;
+    bool oddSample = false;
+};
+
+/**
+    Stereo analyser with roughly the same resolution per octave over the whole axis.
+    The input is halved in rate octave after octave and each rate gets its own small
+    FFT. Band b runs at fs / 2^b and only shows 0.2 to 0.4 of its rate, where its bins
+    are fs / 2^b / fftSize apart : the bin spacing follows the log axis. The top band
+    reaches up to Nyquist and the bottom one down to DC. Bands lying above 20 kHz are
+    still decimated through but never transformed.
+
+    Each band keeps its own window and hop. A band is transformed once a hop of its own
+    (decimated) samples came in, the low octaves are therefore refreshed less often.
+ */
+struct MultirateSpectrum
+{
+    static constexpr int numChannels = 2;
+    static constexpr int order = 8;
+    static constexpr int fftSize = 1 << order;
+    static constexpr int numBins = fftSize / 2;
+    static constexpr int maxBands = SpectrumLayout::maxBands;
+
+    //Allocates
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        layout = {};
+
+        //Octaves down until the bottom band's range starts below 20 Hz
+        int numBands = 1;
+
+        while ( numBands < maxBands && lowerEdge * sampleRate / (double)(1 << (numBands - 1)) > 20.0 )
+            ++numBands;
+
+        bands.resize((size_t)numBands);
+
+        for ( int b = 0; b < numBands; ++b )
+        {
+            auto& band = bands[(size_t)b];
+            auto bandRate = sampleRate / (double)(1 << b);
+            auto lowest = b == numBands - 1 ? 0.0 : lowerEdge * bandRate;
+            auto highest = b == 0 ? bandRate / 2.0 : upperEdge * bandRate;
+
+            for ( auto& window : band.windows )
+                window.assign((size_t)fftSize, 0.f);
+
+            band.layoutIndex = -1;
+
+            if ( lowest < 20000.0 )
+            {
+                band.layoutIndex = layout.getNumBands();
+                layout.addBand(numBins, bandRate / (double)fftSize, lowest, highest);
+            }
+        }
+
+        frame.assign((size_t)(numChannels * layout.getNumBins()), 0.f);
+
+        for ( auto& buffer : scratch )
+            buffer.resize((size_t)(maxBlockSize / 2 + 1));
+
+        transform.prepare(order);
+
+        reset();
+    }
+
+    //Drops every sample seen so far
+    void reset()
+    {
+        for ( auto& band : bands )
+        {
+            for ( auto& window : band.windows )
+                std::fill(window.begin(), window.end(), 0.f);
+
+            for ( auto& decimator : band.decimators )
+                decimator.reset();
+
+            band.samplesSinceLastFrame = 0;
+        }
+
+        //Every band is transformed on the next produce(), the frame never shows unset bins
+        transformAll = true;
+    }
+
+    //Both channels are fed the same samples, the left one keeps the count
+    void push(int channel, const float* data, int numSamples)
+    {
+        while ( numSamples > 0 )
+        {
+            auto blockSize = juce::jmin(numSamples, maxBlockSize);
+            const auto* in = data;
+            auto numIn = blockSize;
+
+            for ( size_t b = 0; b < bands.size() && numIn > 0; ++b )
+            {
+                auto& band = bands[b];
+                appendToWindow(band.windows[(size_t)channel], in, numIn);
+
+                if ( channel == 0 )
+                    band.samplesSinceLastFrame += numIn;
+
+                //The next octave down
+                if ( b + 1 < bands.size() )
+                {
+                    auto* out = scratch[b & 1].data();
+                    numIn = band.decimators[(size_t)channel].process(in, numIn, out);
+                    in = out;
+                }
+            }
+
+            data += blockSize;
+            numSamples -= blockSize;
+        }
+    }
+
+    //Transforms the bands a hop of samples came in for, returns false when none did
+    bool produce(StereoView view, int overlap, float minusInfinityDb)
+    {
+        const auto hopSize = juce::jmax(1, fftSize / overlap);
+        const auto numLayoutBins = layout.getNumBins();
+        bool updated = false;
+
+        for ( auto& band : bands )
+        {
+            if ( band.layoutIndex < 0 || (band.samplesSinceLastFrame < hopSize && ! transformAll) )
+                continue;
+
+            band.samplesSinceLastFrame %= hopSize;
+
+            auto* first = frame.data() + layout.getBand(band.layoutIndex).firstBin;
+            auto* second = first + numLayoutBins;
+
+            transform.perform(band.windows[0].data(), band.windows[1].data(), view, first, second);
+            gainsToDecibels(first, numBins, minusInfinityDb);
+            gainsToDecibels(second, numBins, minusInfinityDb);
+
+            updated = true;
+        }
+
+        transformAll = false;
+        return updated;
+    }
+
+    //Two spectra of getLayout().getNumBins() decibels, one after the other
+    const std::vector<float>& getFrame() const { return frame; }
+    const SpectrumLayout& getLayout() const { return layout; }
+    double getSampleRate() const { return sampleRate; }
+
+private:
+    //Part of each band's own rate it shows
+    static constexpr double lowerEdge = 0.2;
+    static constexpr double upperEdge = 0.4;
+    //Samples decimated at once, bounds the scratch buffers
+    static constexpr int maxBlockSize = 1024;
+
+    struct Band
+    {
+        //The last fftSize samples of each channel at this band's rate
+        std::array<std::vector<float>, numChannels> windows;
+        //Feed the band below
+        std::array<HalfBandDecimator, numChannels> decimators;
+        int samplesSinceLastFrame = 0;
+        //-1 : above the axis, not transformed
+        int layoutIndex = -1;
+    };
+
+    double sampleRate = 0;
+    std::vector<Band> bands;
+    SpectrumLayout layout;
+    std::vector<float> frame;
+    std::array<std::vector<float>, 2> scratch;
+    StereoSpectrumTransform transform;
+    bool transformAll = true;
+
+    static void appendToWindow(std::vector<float>& window, const float* data, int numSamples)
+    {
+        const auto size = (int)window.size();
+
+        if ( numSamples >= size )
+        {
+            std::copy(data + numSamples - size, data + numSamples, window.begin());
+            return;
+        }
+
+        std::copy(window.begin() + numSamples, window.end(), window.begin());
+        std::copy(data, data + numSamples, window.end() - numSamples);
+    }
+};
@@ -274,11 +274,82 @@ juce::String RotarySliderWithLabels::getDisplayString() const
     }
     return str;
 }
+//==============================================================================
+SpectrogramImage::SpectrogramImage()
+{
+    using namespace juce;
+    
+    //From the floor up : black, deep blue, purple, orange, then pale yellow at 0 dB
+    ColourGradient gradient(Colours::black, 0.f, 0.f, Colour(255u, 250u, 200u), 1.f, 0.f, false);
+    gradient.addColour(0.25, Colour(20u, 20u, 110u));
+    gradient.addColour(0.5, Colour(140u, 30u, 140u));
+    gradient.addColour(0.75, Colour(240u, 120u, 30u));
+    
+    gradient.createLookupTable(colourTable.data(), numColours);
+}
+
+void SpectrogramImage::pushLine(const float* first, const float* second, int numColumns, int height, float minusInfinityDb)
+{
+    using namespace juce;
+    
+    if ( numColumns <= 0 || height <= 0 )
+        return;
+    
+    if ( image.getWidth() != numColumns || image.getHeight() != height )
+    {
+        //Software image : writing a line doesn't go through the native image's locking
+        image = Image(Image::RGB, numColumns, height, true, SoftwareImageType());
+        newestLine = 0;
+    }
+    
+    //The ring runs upwards, so the newest line is always on top of the older ones
+    newestLine = newestLine == 0 ? height - 1 : newestLine - 1;
+    
+    Image::BitmapData line(image, 0, newestLine, numColumns, 1, Image::BitmapData::writeOnly);
+    const auto scale = (float)(numColours - 1) / -minusInfinityDb;
+    
+    for ( int x = 0; x < numColumns; ++x )
+    {
+        auto db = jmax(first[x], second[x]);
+        auto index = jlimit(0, numColours - 1, (int)((db - minusInfinityDb) * scale));
+        
+        reinterpret_cast<PixelRGB*>(line.getPixelPointer(x, 0))->set(colourTable[(size_t)index]);
+    }
+}
+
+void SpectrogramImage::draw(juce::Graphics& g, juce::Rectangle<int> area) const
+{
+    if ( ! image.isValid() )
+        return;
+    
+    //The newest lines down to the end of the image first, then the oldest ones from its top
+    const auto width = image.getWidth();
+    const auto numNewest = image.getHeight() - newestLine;
+    
+    g.drawImage(image, area.getX(), area.getY(), width, numNewest, 0, newestLine, width, numNewest);
+    
+    if ( newestLine > 0 )
+        g.drawImage(image, area.getX(), area.getY() + numNewest, width, newestLine, 0, 0, width, newestLine);
+}
+
+void SpectrogramImage::clear()
+{
+    if ( image.isValid() )
+        image.clear(image.getBounds());
+    
+    newestLine = 0;
+}
+
 //==============================================================================
 ResponseCurveComponent::ResponseCurveComponent(ZooEQAudioProcessor& p) :
 audioProcessor(p),
-leftPathProducer(audioProcessor.leftChannelFifo),
-rightPathProducer(audioProcessor.rightChannelFifo)
+pathProducer(audioProcessor.leftChannelFifo, audioProcessor.rightChannelFifo),
+analyserResolution(audioProcessor.apvts.getRawParameterValue("Analyser Resolution")),
+analyserChannels(audioProcessor.apvts.getRawParameterValue("Analyser Channels")),
+analyserMode(audioProcessor.apvts.getRawParameterValue("Analyser Mode")),
+analyserAveraging(audioProcessor.apvts.getRawParameterValue("Analyser Averaging")),
+analyserOverlap(audioProcessor.apvts.getRawParameterValue("Analyser Overlap")),
+analyserPeakHold(audioProcessor.apvts.getRawParameterValue("Analyser Peak Hold"))
 {
     const auto& params = audioProcessor.getParameters();
     for( auto params : params )
@@ -286,11 +357,24 @@ rightPathProducer(audioProcessor.rightChannelFifo)
         params->addListener(this);
     }
     updateChain();
+    
+    //Doesn't attach to the processor's tap if the analyser starts disabled
+    toggleAnalysisEnablement(audioProcessor.apvts.getRawParameterValue("Analyser Enable")->load() > 0.5f);
+    
+    analysisThread->addClient(&pathProducer);
+    
+   #if ZOOEQ_USE_VBLANK
+    vBlankAttachment = std::make_unique<juce::VBlankAttachment>(this, [this] { onFrame(); });
+   #else
     startTimerHz(60);
+   #endif
 }
 
 ResponseCurveComponent::~ResponseCurveComponent()
 {
+    //Must happen before the producer is destroyed
+    analysisThread->removeClient(&pathProducer);
+    
     const auto& params = audioProcessor.getParameters();
     for( auto params : params )
     {
@@ -303,96 +387,428 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
     parametersChanged.set(true);
 }
 
+//==============================================================================
+void PathProducer::setAnalysisArea(juce::Rectangle<float> fftBounds, double sampleRate)
+{
+    const juce::SpinLock::ScopedLockType sl(areaLock);
+    analysisArea = fftBounds;
+    analysisSampleRate = sampleRate;
+}
+
+void PathProducer::setEnabled(bool shouldBeEnabled)
+{
+    if ( enabled == shouldBeEnabled )
+        return;
+    
+    //The analysis thread reads the generation before anything else : when it sees the new one,
+    //it also sees the pending reset
+    if ( shouldBeEnabled )
+    {
+        resetPending = true;
+        ++generation;
+        enabled = true;
+        
+        for ( auto* fifo : channelFifos )
+            fifo->addConsumer();
+    }
+    else
+    {
+        enabled = false;
+        ++generation;
+        
+        for ( auto* fifo : channelFifos )
+            fifo->removeConsumer();
+    }
+    
+    //Neither the last paths nor a frame still in flight must show up when the analyser comes back,
+    //pullLatestColumns() refuses the frames of the previous generations
+    spectrumColumns.clear();
+    
+    for ( auto* paths : { &fftPaths, &peakPaths } )
+    {
+        for ( auto& path : *paths )
+            path.clear();
+    }
+    
+    showingSilence = false;
+}
+
+void PathProducer::runAnalysis()
+{
+    analysisGeneration = generation.load();
+    
+    if ( ! enabled )
+        return;
+    
+    if ( resetPending.exchange(false) )
+    {
+        for ( auto* fifo : channelFifos )
+            fifo->discardAvailable();
+        
+        analysisWindow.clear();
+        multirateSpectrum.reset();
+        rasteriser.reset();
+        samplesSinceLastFrame = 0;
+    }
+    
+    //Whichever analysis takes over starts from silence, its window went stale while the other one ran
+    if ( auto shouldUseMultirate = requestedMultirate.load(); shouldUseMultirate != multirate )
+    {
+        multirate = shouldUseMultirate;
+        analysisWindow.clear();
+        multirateSpectrum.reset();
+        samplesSinceLastFrame = 0;
+    }
+    
+    if ( auto order = requestedOrder.load(); order != fftDataGenerator->getOrder() )
+        changeOrder(order);
+    
+    juce::Rectangle<float> fftBounds;
+    double sampleRate;
+    
+    {
+        const juce::SpinLock::ScopedLockType sl(areaLock);
+        fftBounds = analysisArea;
+        sampleRate = analysisSampleRate;
+    }
+    
+    //Not laid out or not prepared yet
+    if ( fftBounds.isEmpty() || sampleRate <= 0 )
+        return;
+    
+    process(fftBounds, sampleRate);
+}
+
+void PathProducer::changeOrder(FFTOrder newOrder)
+{
+    //Everything is built aside first, then swapped in between two frames
+    auto generator = std::make_unique<FFTDataGenerator<std::vector<float>>>();
+    generator->changeOrder(newOrder);
+    const auto fftSize = generator->getFFTSize();
+    
+    juce::AudioBuffer<float> window(numChannels, fftSize);
+    window.clear();
+    std::vector<float> frame((size_t)fftSize, 0);
+    
+    //The most recent samples carry over, the new resolution doesn't start from silence
+    if ( auto numToKeep = juce::jmin(fftSize, analysisWindow.getNumSamples()); numToKeep > 0 )
+    {
+        for ( int ch = 0; ch < numChannels; ++ch )
+        {
+            juce::FloatVectorOperations::copy(window.getWritePointer(ch, fftSize - numToKeep),
+                                              analysisWindow.getReadPointer(ch, analysisWindow.getNumSamples() - numToKeep),
+                                              numToKeep);
+        }
+    }
+    
+    std::swap(fftDataGenerator, generator);
+    std::swap(analysisWindow, window);
+    std::swap(fftData, frame);
+    
+    //Shows the new resolution on the next call instead of a hop later
+    samplesSinceLastFrame = fftSize;
+}
+
 void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    if ( multirate && multirateSpectrum.getSampleRate() != sampleRate )
+        multirateSpectrum.prepare(sampleRate);
     
-    while (leftChannelFifo->getNumCompleteBuffersAvailable() > 0)
+    //Everything that came in since the last call goes straight from the rings to the end of the FFT window,
+    //however the host sliced it into blocks
+    const auto windowSize = analysisWindow.getNumSamples();
+    
+    for ( int ch = 0; ch < numChannels; ++ch )
     {
-        if ( leftChannelFifo->getAudioBuffer(tempIncomingBuffer) )
+        auto* fifo = channelFifos[(size_t)ch];
+        auto incoming = fifo->getAvailableSamples();
+        auto numIncoming = incoming.getNumSamples();
+        
+        if ( numIncoming == 0 )
+            continue;
+        
+        if ( multirate )
         {
-            auto size = tempIncomingBuffer.getNumSamples();
-            
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                              monoBuffer.getReadPointer(0, size),
-                                              monoBuffer.getNumSamples() - size);
-            
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                                              tempIncomingBuffer.getReadPointer(0, 0),
-                                              size);
-            
-            leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
+            //The octave bank takes every sample, it keeps its own windows
+            multirateSpectrum.push(ch, incoming.data1, incoming.size1);
+            multirateSpectrum.push(ch, incoming.data2, incoming.size2);
+            fifo->finishedRead(numIncoming);
+            continue;
         }
+        
+        auto size = juce::jmin(numIncoming, windowSize);
+        
+        juce::FloatVectorOperations::copy(analysisWindow.getWritePointer(ch, 0),
+                                          analysisWindow.getReadPointer(ch, size),
+                                          windowSize - size);
+        
+        incoming.copyLast(analysisWindow.getWritePointer(ch, windowSize - size), size);
+        fifo->finishedRead(numIncoming);
+        
+        //Both rings are fed by the same blocks, the left one keeps the count
+        if ( ch == 0 )
+            samplesSinceLastFrame += numIncoming;
+    }
+    
+    const auto numColumns = juce::roundToInt(fftBounds.getWidth());
+    
+    if ( multirate )
+    {
+        //At most one FFT per band and displayed frame as well
+        if ( multirateSpectrum.produce(view.load(), overlap.load(), minusInfinityDb) )
+            rasteriser.rasterise(multirateSpectrum.getFrame(), numChannels, numColumns, multirateSpectrum.getLayout(), averaging.load(),
+                                 analysisGeneration);
+        
+        return;
+    }
+    
+    //At most one FFT per displayed frame, and only once a whole hop of new samples is in.
+    //The hops that went by in between would never have been shown, they are skipped.
+    const auto hopSize = juce::jmax(1, fftDataGenerator->getFFTSize() / overlap.load());
+    
+    if ( samplesSinceLastFrame >= hopSize )
+    {
+        samplesSinceLastFrame %= hopSize;
+        fftDataGenerator->produceFFTDataForRendering(analysisWindow, view.load(), minusInfinityDb);
     }
+    
     /**
      if there are FFT data buffers to pull
         if we can pull a buffer
-            generate a path
+            reduce it to one value per pixel column
      */
-    const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
-    /**
-        4800 / 2048 = 23Hz <- this is bind width
-     */
-    const auto binWidth = sampleRate / (double) fftSize;
+    const auto layout = SpectrumLayout::linear(fftDataGenerator->getFFTSize(), sampleRate);
     
-    while ( leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0 )
+    while ( fftDataGenerator->getNumAvailableFFTDataBlocks() > 0 )
     {
-        std::vector<float> fftData;
-        if (leftChannelFFTDataGenerator.getFFTData(fftData))
+        if (fftDataGenerator->getFFTData(fftData))
         {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
+            rasteriser.rasterise(fftData, numChannels, numColumns, layout, averaging.load(), analysisGeneration);
         }
     }
-    /**
-        while there are paths that we can pull
-            pull as many as we can
-                display the most recent path
-     */
-    while (pathProducer.getNumPathsAvailable() )
+}
+
+void PathProducer::logStatistics() const
+{
+    const std::pair<const char*, FifoStatistics> statistics[] =
+    {
+        { "left tap (samples)", channelFifos[0]->getStatistics() },
+        { "right tap (samples)", channelFifos[1]->getStatistics() },
+        { "FFT frames", fftDataGenerator->getStatistics() }
+    };
+    
+    for ( const auto& [name, stats] : statistics )
     {
-        pathProducer.getPath(leftChannelFFTPath);
+        if ( stats.hasDropped() )
+            juce::Logger::writeToLog(juce::String("ZooEQ analyser, ") + name + " : " + stats.toString());
     }
 }
 
-void ResponseCurveComponent::timerCallback()
+bool PathProducer::pullLatestColumns()
+{
+    return rasteriser.getLatestColumns(spectrumColumns, generation.load()) && ! spectrumColumns.empty();
+}
+
+bool PathProducer::updatePaths(juce::Rectangle<float> fftBounds, bool withPeaks)
 {
-    //Check is analysis enable button is ON before processing
+    if ( spectrumColumns.empty() )
+        return false;
+    
+    //Stopped or silent audio keeps producing floor-level frames, there is no need to draw them again.
+    //The peaks only count when they are drawn : they keep falling for a while after the rest.
+    const auto numColumns = (size_t)getNumColumns();
+    const auto numShown = (withPeaks ? 2 : 1) * numChannels * numColumns;
+    auto isSilent = juce::FloatVectorOperations::findMaximum(spectrumColumns.data(), (int)numShown) <= minusInfinityDb;
+    
+    if ( isSilent && showingSilence && fftBounds == pathBounds && withPeaks == pathsHavePeaks )
+        return false;
+    
+    showingSilence = isSilent;
+    pathBounds = fftBounds;
+    pathsHavePeaks = withPeaks;
+    
+    //One point per pixel column, clear() keeps the paths' storage
+    auto bottom = fftBounds.getHeight();
+    
+    auto map = [bottom](float v)
+    {
+        return juce::jmap(v, minusInfinityDb, 0.f, bottom, 0.f);
+    };
+    
+    auto build = [&map, numColumns](juce::Path& path, const float* columns)
+    {
+        path.clear();
+        path.startNewSubPath(0, map(columns[0]));
+        
+        for ( size_t x = 1; x < numColumns; ++x )
+        {
+            path.lineTo((float)x, map(columns[x]));
+        }
+    };
+    
+    for ( int ch = 0; ch < numChannels; ++ch )
+    {
+        build(fftPaths[(size_t)ch], getColumns(ch));
+        
+        if ( withPeaks )
+            build(peakPaths[(size_t)ch], getPeaks(ch));
+    }
+    
+    return true;
+}
+
+void ResponseCurveComponent::updateAnalyserAttachment()
+{
+    auto shouldAttach = shouldShowFFTAnalysis && isShowing();
+    
+    if ( shouldAttach == pathProducer.isEnabled() )
+        return;
+    
+    //Until then the audio thread skips the tap and the analysis passes return straight away
+    pathProducer.setEnabled(shouldAttach);
+    spectrogram.clear();
+}
+
+void ResponseCurveComponent::onFrame()
+{
+    //Minimising doesn't call visibilityChanged(), the frames catch it
+    updateAnalyserAttachment();
+    
+    //Hidden or minimised : nothing gets analysed or drawn until it shows again
+    if ( ! isShowing() )
+        return;
+    
+    bool needsRepaint = false;
+    
+    //The FFTs run on the analysis thread, only the finished paths are picked up here
     if (shouldShowFFTAnalysis)
     {
         auto fftBounds = getAnalysisArea().toFloat();
         auto sampleRate = audioProcessor.getSampleRate();
         
-        leftPathProducer.process(fftBounds, sampleRate);
-        rightPathProducer.process(fftBounds, sampleRate);
+        pathProducer.setAnalysisArea(fftBounds, sampleRate);
+        //The FFT sizes come first, then the octave band analyser
+        auto resolution = juce::roundToInt(analyserResolution->load());
+        auto useMultirate = resolution > FFTOrder::order8192 - FFTOrder::order2048;
+        
+        pathProducer.setMultirate(useMultirate);
+        
+        if ( ! useMultirate )
+            pathProducer.setOrder(static_cast<FFTOrder>(FFTOrder::order2048 + resolution));
+        pathProducer.setView(static_cast<StereoView>(juce::roundToInt(analyserChannels->load())));
+        pathProducer.setAveraging(static_cast<SpectrumAveraging>(juce::roundToInt(analyserAveraging->load())));
+        pathProducer.setOverlap(2 << juce::roundToInt(analyserOverlap->load()));
+        
+        //The peak trace comes and goes at once, it is part of every frame
+        if ( auto peakHold = analyserPeakHold->load() > 0.5f; peakHold != showPeaks )
+        {
+            showPeaks = peakHold;
+            pathProducer.updatePaths(fftBounds, showPeaks);
+            needsRepaint = true;
+        }
+        
+        //A mode change starts the spectrogram's history over
+        if ( auto spectrogramMode = analyserMode->load() > 0.5f; spectrogramMode != showSpectrogram )
+        {
+            showSpectrogram = spectrogramMode;
+            spectrogram.clear();
+            needsRepaint = true;
+        }
+        
+        //display the most recent spectrum, the older ones are skipped
+        if ( pathProducer.pullLatestColumns() )
+        {
+            if ( showSpectrogram )
+            {
+                spectrogram.pushLine(pathProducer.getColumns(0),
+                                     pathProducer.getColumns(1),
+                                     pathProducer.getNumColumns(),
+                                     juce::roundToInt(fftBounds.getHeight()),
+                                     PathProducer::minusInfinityDb);
+                needsRepaint = true;
+            }
+            else
+            {
+                needsRepaint |= pathProducer.updatePaths(fftBounds, showPeaks);
+            }
+        }
+        
+        //Paces the analysis on the display : one frame is computed per frame shown.
+        //Only this editor's producer runs for it, the other editors keep their own pace.
+        analysisThread->requestAnalysis(&pathProducer);
     }
     
-    if ( parametersChanged.compareAndSetBool(false, true) )
+    //A new sample rate changes the coefficients just as much as a parameter
+    if ( parametersChanged.compareAndSetBool(false, true) || audioProcessor.getSampleRate() != chainSampleRate )
     {
         updateChain();
+        needsRepaint = true;
     }
-    repaint();
+    
+    //The labels and the grid live in the background image, only the plot gets invalidated
+    if ( needsRepaint )
+        repaint(getRenderArea());
 }
 
 void ResponseCurveComponent::updateChain()
 {
-    //update the monochain
+    //Same designs as the processor's, straight in double
     auto chainSettings = getChainSettings(audioProcessor.apvts);
+    chainSampleRate = audioProcessor.getSampleRate();
+    numActiveSections = 0;
+    
+    if ( chainSampleRate <= 0 )
+        return;
+    
+    if ( ! chainSettings.peakBypassed )
+        activeSections[(size_t)numActiveSections++] = makePeakBiquad(chainSettings, chainSampleRate);
+    
+    for ( const auto& cut : { makeLowCutCoefficients(chainSettings, chainSampleRate),
+                              makeHighCutCoefficients(chainSettings, chainSampleRate) } )
+    {
+        if ( cut.bypassed )
+            continue;
+        
+        //12 dB/Oct per section
+        for ( int i = 0; i <= (int)cut.slope; ++i )
+            activeSections[(size_t)numActiveSections++] = cut.sections[(size_t)i];
+    }
+    
+    updateResponseCurve();
+}
+
+void ResponseCurveComponent::updateResponseCurve()
+{
+    using namespace juce;
+    
+    auto responseArea = getAnalysisArea();
+    auto w = responseArea.getWidth();
+    
+    responseCurve.clear();
+    
+    if ( w <= 0 || chainSampleRate <= 0 )
+        return;
     
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    if ( ! responseTable.matches(w, chainSampleRate) )
+        responseTable.prepare(w, chainSampleRate);
     
-    //Apply PeakCut Filter changes on the white line
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    responseDecibels.resize((size_t)w);
+    responseTable.computeDecibels(activeSections.data(), numActiveSections, responseDecibels.data());
+    
+    const double outputMin = responseArea.getBottom();
+    const double outputMax = responseArea.getY();
+    
+    auto map = [outputMin,outputMax](double input)
+    {
+        return jmap(input, -24.0, 24.0, outputMin, outputMax);
+    };
     
-    //Apply LowCut Filter changes on the white line
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
+    responseCurve.startNewSubPath(responseArea.getX(), map(responseDecibels.front()));
     
-    //Apply HighCut Filter changes on the white line
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    for ( size_t i = 1; i<responseDecibels.size(); ++i )
+    {
+        responseCurve.lineTo(responseArea.getX() + i, map(responseDecibels[i]));
+    }
 }
 
 void ResponseCurveComponent::paint (juce::Graphics& g)
@@ -421,91 +837,40 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     
     auto responseArea = getAnalysisArea();
     
-    auto w = responseArea.getWidth();
-    
-    auto& lowcut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highcut = monoChain.get<ChainPositions::HighCut>();
-    
-    auto sampleRate = audioProcessor.getSampleRate();
-    
-    std::vector<double> mags;
-    mags.resize(w);
-    
-    for ( int i = 0; i < w; ++i )
-    {
-        double mag = 1.f;
-        auto freq = mapToLog10((double(i)/double(w)), 20.0, 20000.0);
-        
-        //Peak
-        if(! monoChain.isBypassed<ChainPositions::Peak>())
-            mag *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        
-        //Low Cut
-        if (! monoChain.isBypassed<ChainPositions::LowCut>() )
-        {
-            if( !lowcut.isBypassed<0>() )
-                mag *= lowcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !lowcut.isBypassed<1>() )
-                mag *= lowcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !lowcut.isBypassed<2>() )
-                mag *= lowcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !lowcut.isBypassed<3>() )
-                mag *= lowcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
-        
-        //High Cut
-        if (! monoChain.isBypassed<ChainPositions::HighCut>() )
-        {
-            if( !highcut.isBypassed<0>() )
-                mag *= highcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !highcut.isBypassed<1>() )
-                mag *= highcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !highcut.isBypassed<2>() )
-                mag *= highcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !highcut.isBypassed<3>() )
-                mag *= highcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
-        mags[i] = Decibels::gainToDecibels(mag);
-    }
-    
-    Path responseCurve;
-    const double outputMin = responseArea.getBottom();
-    const double outputMax = responseArea.getY();
-    
-    auto map = [outputMin,outputMax](double input)
-    {
-        return jmap(input, -24.0, 24.0, outputMin, outputMax);
-    };
-    
-    responseCurve.startNewSubPath(responseArea.getX(), map(mags.front()));
-    
-    for ( size_t i = 1; i<mags.size(); ++i )
+    // === Draw the FFT === //
+    if ( shouldShowFFTAnalysis && showSpectrogram )
     {
-        responseCurve.lineTo(responseArea.getX() + i, map(mags[i]));
+        spectrogram.draw(g, responseArea);
     }
-    
-    // === Draw the FFT === //
-    if ( shouldShowFFTAnalysis )
+    else if ( shouldShowFFTAnalysis )
     {
-        //Left channel
-        auto leftChannelFFTPath = leftPathProducer.getPath();
-        leftChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        //The paths are drawn where they are, shifted by the transform rather than copied
+        auto toAnalysisArea = AffineTransform::translation(responseArea.getX(), responseArea.getY());
+        
+        //Left (or mid) channel
         g.setColour(fftLeftColor);
-        g.strokePath(leftChannelFFTPath, PathStrokeType(2.f));
+        g.strokePath(pathProducer.getPath(0), PathStrokeType(2.f), toAnalysisArea);
         
-        //right channel
-        auto rightChannelFFTPath = rightPathProducer.getPath();
-        rightChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        //right (or side) channel
         g.setColour(fftRightColor);
-        g.strokePath(rightChannelFFTPath, PathStrokeType(2.f));
+        g.strokePath(pathProducer.getPath(1), PathStrokeType(2.f), toAnalysisArea);
+        
+        //Held peaks, thinner and fainter above the curves
+        if ( showPeaks )
+        {
+            g.setColour(fftLeftColor.withAlpha(0.6f));
+            g.strokePath(pathProducer.getPeakPath(0), PathStrokeType(1.f), toAnalysisArea);
+            
+            g.setColour(fftRightColor.withAlpha(0.6f));
+            g.strokePath(pathProducer.getPeakPath(1), PathStrokeType(1.f), toAnalysisArea);
+        }
     }
     
     //Draw the render area outline
     g.setColour(backgroundOutlineColor);
     g.drawRoundedRectangle(getRenderArea().toFloat(), cornerSizeDisplay, lineThicknessDisplay);
  
-    //Draw the reponse curve
+    //Draw the reponse curve (built by updateResponseCurve)
     g.setColour(responseCurveColor);
     g.strokePath(responseCurve, PathStrokeType(strokeThickness));
     
@@ -515,6 +880,8 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
 void ResponseCurveComponent::resized()
 {
     using namespace juce;
+    updateResponseCurve();
+    
     background = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
     Graphics g(background);
     
@@ -693,7 +1060,17 @@ highCutSlopeSliderAttachment(audioProcessor.apvts, "HighCut Slope", highCutSlope
 lowcutBypassButtonAttachment(audioProcessor.apvts, "LowCut Bypassed", lowcutBypassButton),
 peakBypassButtonAttachment(audioProcessor.apvts, "Peak Bypassed", peakBypassButton),
 highcutBypassButtonAttachment(audioProcessor.apvts, "HighCut Bypassed", highcutBypassButton),
-analyserEnableButtonAttachment(audioProcessor.apvts, "Analyser Enable", analyserEnableButton)
+analyserEnableButtonAttachment(audioProcessor.apvts, "Analyser Enable", analyserEnableButton),
+
+analyserResolutionBox(*audioProcessor.apvts.getParameter("Analyser Resolution")),
+analyserChannelsBox(*audioProcessor.apvts.getParameter("Analyser Channels")),
+analyserModeBox(*audioProcessor.apvts.getParameter("Analyser Mode")),
+analyserAveragingBox(*audioProcessor.apvts.getParameter("Analyser Averaging")),
+analyserResolutionBoxAttachment(audioProcessor.apvts, "Analyser Resolution", analyserResolutionBox),
+analyserChannelsBoxAttachment(audioProcessor.apvts, "Analyser Channels", analyserChannelsBox),
+analyserModeBoxAttachment(audioProcessor.apvts, "Analyser Mode", analyserModeBox),
+analyserAveragingBoxAttachment(audioProcessor.apvts, "Analyser Averaging", analyserAveragingBox),
+analyserPeakHoldButtonAttachment(audioProcessor.apvts, "Analyser Peak Hold", analyserPeakHoldButton)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -773,6 +1150,14 @@ analyserEnableButtonAttachment(audioProcessor.apvts, "Analyser Enable", analyser
         }
     };
     
+    //The capture may have been running since before the editor opened
+    captureButton.setToggleState(audioProcessor.getSpectrumCapture().isCapturing(), juce::dontSendNotification);
+    captureButton.onClick = [safePtr]()
+    {
+        if (auto* comp = safePtr.getComponent())
+            comp->showCaptureMenu();
+    };
+    
     setSize (600, 400); //Size of the window
 }
 
@@ -810,6 +1195,23 @@ void ZooEQAudioProcessorEditor::resized()
     analyzerEnableArea.removeFromTop(2); //To don't be glue to the top bound window
     analyserEnableButton.setBounds(analyzerEnableArea);
     
+    auto analyserResolutionArea = analyzerEnableArea.withX(analyzerEnableArea.getRight() + 5).withWidth(90);
+    analyserResolutionBox.setBounds(analyserResolutionArea);
+    
+    auto analyserChannelsArea = analyserResolutionArea.withX(analyserResolutionArea.getRight() + 5).withWidth(90);
+    analyserChannelsBox.setBounds(analyserChannelsArea);
+    
+    auto analyserModeArea = analyserChannelsArea.withX(analyserChannelsArea.getRight() + 5).withWidth(100);
+    analyserModeBox.setBounds(analyserModeArea);
+    
+    auto analyserAveragingArea = analyserModeArea.withX(analyserModeArea.getRight() + 5).withWidth(90);
+    analyserAveragingBox.setBounds(analyserAveragingArea);
+    
+    auto analyserPeakHoldArea = analyserAveragingArea.withX(analyserAveragingArea.getRight() + 5).withWidth(85);
+    analyserPeakHoldButton.setBounds(analyserPeakHoldArea);
+    
+    captureButton.setBounds(analyserPeakHoldArea.withX(analyserPeakHoldArea.getRight() + 5).withWidth(50));
+    
     bounds.removeFromTop(5);
     
     float hRatio = 32.f / 100.f;// JUCE_LIVE_CONSTANT(33) / 100.f;
@@ -835,6 +1237,97 @@ void ZooEQAudioProcessorEditor::resized()
     peakQualitySlider.setBounds(bounds);
 }
 
+void ZooEQAudioProcessorEditor::showCaptureMenu()
+{
+    auto& capture = audioProcessor.getSpectrumCapture();
+    auto canExport = capture.getSecondsCaptured() > 0;
+    
+    juce::PopupMenu menu;
+    menu.addSectionHeader("Long-term spectrum : " + juce::String(capture.getSecondsCaptured(), 1) + " s");
+    menu.addItem(1, capture.isCapturing() ? "Stop capture" : "Start a new capture");
+    menu.addItem(2, "Export CSV...", canExport);
+    menu.addItem(3, "Export binary...", canExport);
+    
+    //The top bar has no room left for the analyser's hop, it is chosen here
+    static constexpr int overlapItemOffset = 100;
+    auto* overlap = audioProcessor.apvts.getParameter("Analyser Overlap");
+    auto overlapChoices = overlap->getAllValueStrings();
+    auto currentOverlap = juce::roundToInt(overlap->convertFrom0to1(overlap->getValue()));
+    
+    menu.addSectionHeader("Analyser overlap");
+    
+    for ( int i = 0; i < overlapChoices.size(); ++i )
+        menu.addItem(overlapItemOffset + i, overlapChoices[i], true, i == currentOverlap);
+    
+    auto safePtr = juce::Component::SafePointer<ZooEQAudioProcessorEditor>(this);
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&captureButton), [safePtr](int result)
+    {
+        auto* editor = safePtr.getComponent();
+        
+        if ( editor == nullptr || result == 0 )
+            return;
+        
+        if ( result >= overlapItemOffset )
+        {
+            auto* overlap = editor->audioProcessor.apvts.getParameter("Analyser Overlap");
+            overlap->beginChangeGesture();
+            overlap->setValueNotifyingHost(overlap->convertTo0to1((float)(result - overlapItemOffset)));
+            overlap->endChangeGesture();
+            return;
+        }
+        
+        auto& capture = editor->audioProcessor.getSpectrumCapture();
+        
+        if ( result == 1 )
+        {
+            if ( capture.isCapturing() )
+                capture.stop();
+            else
+                capture.start();
+            
+            editor->captureButton.setToggleState(capture.isCapturing(), juce::dontSendNotification);
+        }
+        else
+        {
+            editor->exportCapture(result == 2);
+        }
+    });
+}
+
+void ZooEQAudioProcessorEditor::exportCapture(bool asCSV)
+{
+    const juce::String extension = asCSV ? ".csv" : ".ltas";
+    auto defaultFile = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("ZooEQ LTAS" + extension);
+    
+    exportChooser = std::make_unique<juce::FileChooser>("Export the long-term spectrum", defaultFile, "*" + extension);
+    
+    auto flags = juce::FileBrowserComponent::saveMode
+               | juce::FileBrowserComponent::canSelectFiles
+               | juce::FileBrowserComponent::warnAboutOverwriting;
+    
+    auto safePtr = juce::Component::SafePointer<ZooEQAudioProcessorEditor>(this);
+    
+    exportChooser->launchAsync(flags, [safePtr, asCSV](const juce::FileChooser& chooser)
+    {
+        auto* editor = safePtr.getComponent();
+        auto file = chooser.getResult();
+        
+        //Cancelled
+        if ( editor == nullptr || file == juce::File() )
+            return;
+        
+        auto& capture = editor->audioProcessor.getSpectrumCapture();
+        
+        if ( ! (asCSV ? capture.exportCSV(file) : capture.exportBinary(file)) )
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
+                                                   "Export failed",
+                                                   "The long-term spectrum couldn't be written to " + file.getFullPathName());
+        }
+    });
+}
+
 std::vector<juce::Component*> ZooEQAudioProcessorEditor::getComps()
 {
     return
@@ -849,6 +1342,12 @@ std::vector<juce::Component*> ZooEQAudioProcessorEditor::getComps()
         &lowcutBypassButton,
         &peakBypassButton,
         &highcutBypassButton,
-        &analyserEnableButton
+        &analyserEnableButton,
+        &analyserResolutionBox,
+        &analyserChannelsBox,
+        &analyserModeBox,
+        &analyserAveragingBox,
+        &analyserPeakHoldButton,
+        &captureButton
     };
 }
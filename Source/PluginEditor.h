@@ -10,6 +10,11 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "SpectrumMath.h"
+#include "MultirateSpectrum.h"
+
+//The editor's frames follow the display's vblank where JUCE offers it, a 60 Hz timer otherwise
+#define ZOOEQ_USE_VBLANK (JUCE_MAJOR_VERSION >= 7)
 
 enum FFTOrder
 {
@@ -21,36 +26,29 @@ enum FFTOrder
 template<typename BlockType>
 struct FFTDataGenerator
 {
+    static constexpr int numSpectra = 2;
+    
     /**
-        Produces the FFT data from an audio buffer
+        Produces the FFT data from a stereo buffer, see StereoSpectrumTransform.
+        The frame then holds the two spectra one after the other.
      */
-    void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
+    void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, StereoView view, const float negativeInfinity)
     {
         const auto fftSize = getFFTSize();
-        
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
-        
-        //first apply a windowing unction to our data
-        window->multiplyWithWindowingTable (fftData.data(), fftSize);
-        
-        //then render our fft data
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data());
-        
         int numBins = (int)fftSize / 2;
         
-        //normalise the fft values
-        for( int i=0; i<numBins; ++i)
-        {
-            fftData[i] /= (float) numBins;
-        }
+        //The fifo hands back a slot of the same size
+        jassert(fftData.size() >= (size_t)fftSize);
+        jassert(audioData.getNumChannels() >= numSpectra && audioData.getNumSamples() >= fftSize);
+        
+        transform.perform(audioData.getReadPointer(0),
+                          audioData.getReadPointer(1),
+                          view,
+                          fftData.data(),
+                          fftData.data() + numBins);
         
         //Conversion then to decibel
-        for( int i = 0; i<numBins; ++i )
-        {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
-        }
+        gainsToDecibels(fftData.data(), numSpectra * numBins, negativeInfinity);
         
         fftDataFifo.push(fftData);
     }
@@ -58,95 +56,141 @@ struct FFTDataGenerator
     void changeOrder(FFTOrder newOrder)
     {
         order = newOrder;
-        auto fftSize = getFFTSize();
-        
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize,
-                                                                       juce::dsp::WindowingFunction<float>::blackmanHarris);
+        transform.prepare(order);
         
+        //numSpectra spectra of fftSize / 2 bins
         fftData.clear();
-        fftData.resize(fftSize * 2, 0);
+        fftData.resize(getFFTSize(), 0);
         
         fftDataFifo.prepare(fftData.size());
     }
     //==============================================================================
     int getFFTSize() const {return 1 << order;}
+    FFTOrder getOrder() const {return order;}
     int getNumAvailableFFTDataBlocks() const {return fftDataFifo.getNumAvailableForReading();}
+    FifoStatistics getStatistics() const {return fftDataFifo.getStatistics();}
     //==============================================================================
+    //Swaps : pass the same prepared block every time
     bool getFFTData(BlockType& fftData) {return fftDataFifo.pull(fftData);}
 private:
     FFTOrder order;
     BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    StereoSpectrumTransform transform;
     Fifo<BlockType> fftDataFifo;
 };
 
-template<typename PathType>
-struct AnalyserPathGenerator
+//How the analyser frames are smoothed over time, in the same order as the "Analyser Averaging" choices
+enum SpectrumAveraging
 {
-    /**
-        converts 'renderData[ ]' into a juce::Path
-     */
-    void generatePath(const std::vector<float>& renderData,
-                      juce::Rectangle<float> fftBounds,
-                      int fftSize,
-                      float binWidth,
-                      float negativeInfinity)
+    noAveraging,
+    exponentialAveraging,
+    ballisticAveraging
+};
+
+/**
+    Reduces FFT frames to one value per pixel column of the analysis area and hands
+    them over as compact float arrays, so the editor's work depends on its width only.
+    The columns are smoothed over time and the peaks held right there, on the analysis
+    thread. The columns of every spectrum of a frame follow each other in the same
+    array, then the peak columns of every spectrum.
+
+    Each frame carries the generation it was computed for, so the consumer can refuse
+    frames that were still in flight when it started over.
+ */
+struct SpectrumRasteriser
+{
+    //renderData holds numSpectra spectra of layout.getNumBins() decibels each
+    void rasterise(const std::vector<float>& renderData, int numSpectra, int numColumns, const SpectrumLayout& layout,
+                   SpectrumAveraging averaging, int generation)
     {
-        auto top = fftBounds.getY();
-        auto bottom = fftBounds.getHeight();
-        auto width = fftBounds.getWidth();
+        if ( ! columnMap.matches(numColumns, layout) )
+            columnMap.prepare(numColumns, layout);
         
-        int numBins = (int)fftSize / 2;
+        const auto numBins = layout.getNumBins();
+        numColumns = columnMap.getNumColumns();
+        const auto numValues = numSpectra * numColumns;
         
-        PathType p;
-        p.preallocateSpace(3 * (int)fftBounds.getWidth());
+        jassert(renderData.size() >= (size_t)(numSpectra * numBins));
         
-        auto map = [bottom, top, negativeInfinity](float v)
-        {
-            return juce::jmap(v,
-                              negativeInfinity, 0.f,
-                              float(bottom), top);
-        };
+        //Each of the three buffers only allocates when the width grows
+        auto& frame = columnBuffers.getWriteBuffer();
+        frame.generation = generation;
+        auto& columns = frame.values;
+        columns.resize((size_t)(2 * numValues));
         
-        auto y = map(renderData[0]);
+        if ( ballistics.getNumValues() != numValues )
+            ballistics.prepare(numValues);
         
-        jassert( !std::isnan(y) && ! std::isinf(y) );
+        for ( int i = 0; i < numSpectra; ++i )
+            columnMap.rasterise(renderData.data() + i * numBins, columns.data() + i * numColumns);
         
-        p.startNewSubPath(0, y);
+        //The coefficients follow the time between two frames, however often they come
+        auto now = juce::Time::getMillisecondCounterHiRes();
+        auto elapsed = juce::jlimit(0.0, 0.5, (now - lastFrameTime) * 0.001);
+        lastFrameTime = now;
         
-        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' pixels.
+        auto coefficient = [elapsed](double timeConstant)
+        {
+            return (float)(1.0 - std::exp(-elapsed / timeConstant));
+        };
         
-        for (int binNum=1; binNum < numBins; binNum += pathResolution)
+        auto attack = 1.f, release = 1.f;
+        
+        if ( averaging == SpectrumAveraging::exponentialAveraging )
+        {
+            attack = release = coefficient(averageTime);
+        }
+        else if ( averaging == SpectrumAveraging::ballisticAveraging )
         {
-            y = map(renderData[binNum]);
-            
-            jassert( !std::isnan(y) && ! std::isinf(y) );
-            
-            if ( !std::isnan(y) && ! std::isinf(y) )
-            {
-                auto binFreq = binNum * binWidth;
-                auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-                int binX = std::floor(normalizedBinX * width);
-                p.lineTo(binX, y);
-            }
+            attack = coefficient(attackTime);
+            release = coefficient(releaseTime);
         }
-        pathFifo.push(p);
+        
+        ballistics.process(columns.data(), columns.data() + numValues, attack, release, (float)(peakFallRate * elapsed));
+        
+        columnBuffers.publish();
     }
     
-    int getNumPathsAvailable() const
+    //The smoothing and the peaks start over from the next frame
+    void reset()
     {
-        return pathFifo.getNumAvailableForReading();
+        ballistics.reset();
     }
     
-    bool getPath(PathType& path)
+    //Only the most recent columns are worth drawing, the ones never picked up were overwritten.
+    //A frame from another generation is refused. dest only reallocates when the width grows.
+    bool getLatestColumns(std::vector<float>& dest, int generation)
     {
-        return pathFifo.pull(path);
+        if ( ! columnBuffers.acquire() )
+            return false;
+        
+        const auto& frame = columnBuffers.getReadBuffer();
+        
+        if ( frame.generation != generation )
+            return false;
+        
+        dest = frame.values;
+        return true;
     }
     
 private:
-    Fifo<PathType> pathFifo;
+    //Seconds, and dB per second for the peaks
+    static constexpr double averageTime = 0.25;
+    static constexpr double attackTime = 0.01;
+    static constexpr double releaseTime = 0.5;
+    static constexpr double peakFallRate = 6.0;
+    
+    SpectrumColumnMap columnMap;
+    SpectrumBallistics ballistics;
+    double lastFrameTime = 0;
+    
+    struct ColumnFrame
+    {
+        std::vector<float> values;
+        int generation = 0;
+    };
+    
+    TripleBuffer<ColumnFrame> columnBuffers;
 };
 
 struct LookAndFeel : juce::LookAndFeel_V4
@@ -198,27 +242,144 @@ private:
     juce::String suffix;
 };
 
-struct PathProducer
+/**
+    The stereo analyser : both channels of the processor's tap, one FFT per frame.
+ */
+struct PathProducer : AnalysisClient
 {
-    PathProducer(SingleChannelSampleFifo<ZooEQAudioProcessor::BlockType>& scsf) :
-    leftChannelFifo(&scsf)
+    using ChannelFifo = SingleChannelSampleFifo<ZooEQAudioProcessor::BlockType>;
+    static constexpr int numChannels = FFTDataGenerator<std::vector<float>>::numSpectra;
+    
+    PathProducer(ChannelFifo& leftFifo, ChannelFifo& rightFifo) :
+    channelFifos { &leftFifo, &rightFifo }
     {
-        leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
+        changeOrder(FFTOrder::order2048);
+        
+        for ( auto* fifo : channelFifos )
+            fifo->addConsumer();
+    }
+    
+    ~PathProducer() override
+    {
+        if ( enabled )
+        {
+            for ( auto* fifo : channelFifos )
+                fifo->removeConsumer();
+        }
+        
+        logStatistics();
     }
+    
+    // === Message thread === //
+    void setAnalysisArea(juce::Rectangle<float> fftBounds, double sampleRate);
+    //Attaches to or detaches from the processor's tap
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled; }
+    //The new FFT is built on the analysis thread, the current one keeps running until then
+    void setOrder(FFTOrder newOrder) { requestedOrder = newOrder; }
+    //Applies from the next frame on
+    void setView(StereoView newView) { view = newView; }
+    //Octave band analysis instead of the single FFT, the order is then ignored
+    void setMultirate(bool shouldUseMultirate) { requestedMultirate = shouldUseMultirate; }
+    void setAveraging(SpectrumAveraging newAveraging) { averaging = newAveraging; }
+    //Number of FFT frames per FFT length, the hop between two frames is fftSize / overlap
+    void setOverlap(int newOverlap) { overlap = juce::jlimit(1, maxOverlap, newOverlap); }
+    //Picks up the most recent columns, the older ones are skipped. Returns false when none came in.
+    bool pullLatestColumns();
+    //Left or mid for 0, right or side for 1, getNumColumns() values in dB each
+    const float* getColumns(int index) const { return spectrumColumns.data() + (size_t)index * (size_t)getNumColumns(); }
+    //The held peaks, same layout
+    const float* getPeaks(int index) const { return getColumns(numChannels + index); }
+    int getNumColumns() const { return (int)spectrumColumns.size() / (2 * numChannels); }
+    //Rebuilds the paths from the last columns pulled, returns false when they are silence again
+    bool updatePaths(juce::Rectangle<float> fftBounds, bool withPeaks);
+    //Left or mid for 0, right or side for 1, in fftBounds' own coordinates
+    const juce::Path& getPath(int index) const { return fftPaths[(size_t)index]; }
+    const juce::Path& getPeakPath(int index) const { return peakPaths[(size_t)index]; }
+    
+    // === Analysis thread === //
+    void runAnalysis() override;
     void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return leftChannelFFTPath; }
+    
+    static constexpr int defaultOverlap = 4;
+    static constexpr int maxOverlap = 16;
+    static constexpr float minusInfinityDb = -48.f;
     
 private:
-    SingleChannelSampleFifo<ZooEQAudioProcessor::BlockType>* leftChannelFifo;
+    std::array<ChannelFifo*, numChannels> channelFifos;
+    
+    juce::SpinLock areaLock;
+    juce::Rectangle<float> analysisArea;
+    double analysisSampleRate = 0;
+    std::atomic<bool> enabled { true };
+    //Set on reattach : the analysis thread then drops the samples left over from before
+    std::atomic<bool> resetPending { false };
+    //Bumped on every attach and detach. A frame computed for an older one is never shown,
+    //even if its pass was already running when the analyser was turned off.
+    std::atomic<int> generation { 0 };
+    //The generation the pass in progress computes its frame for
+    int analysisGeneration = 0;
+    std::atomic<FFTOrder> requestedOrder { FFTOrder::order2048 };
+    std::atomic<StereoView> view { StereoView::leftRight };
+    std::atomic<bool> requestedMultirate { false };
+    std::atomic<SpectrumAveraging> averaging { SpectrumAveraging::noAveraging };
+    std::atomic<int> overlap { defaultOverlap };
+    
+    //New samples since the last FFT frame
+    int samplesSinceLastFrame = 0;
+    
+    //The last fftSize samples of each channel
+    juce::AudioBuffer<float> analysisWindow;
+    
+    //Swapped in and out of the generator's fifo
+    std::vector<float> fftData;
+    
+    std::unique_ptr<FFTDataGenerator<std::vector<float>>> fftDataGenerator;
+    
+    void changeOrder(FFTOrder newOrder);
+    
+    //Prepared on the first frame at a new sample rate
+    MultirateSpectrum multirateSpectrum;
+    bool multirate = false;
+    
+    SpectrumRasteriser rasteriser;
+    
+    // === Message thread === //
+    //Leaves a trace in the host's log when the analysis couldn't keep up with the audio
+    void logStatistics() const;
+    
+    std::vector<float> spectrumColumns;
+    std::array<juce::Path, numChannels> fftPaths, peakPaths;
+    juce::Rectangle<float> pathBounds;
+    bool showingSilence = false;
+    bool pathsHavePeaks = false;
+};
+
+/**
+    Scrolling spectrogram on the analyser's frequency axis, newest line at the top. Each
+    analyser frame is written as one line of pixels into a circular image, through a
+    colour table built once. Drawing it is two blits, split where the ring wraps, so a
+    frame costs one line and the blits however long the history is.
+ */
+struct SpectrogramImage
+{
+    SpectrogramImage();
     
-    juce::AudioBuffer<float> monoBuffer;
+    //first and second hold numColumns values in dB, the louder of the two is shown.
+    //A new width or height starts a new, empty, history.
+    void pushLine(const float* first, const float* second, int numColumns, int height, float minusInfinityDb);
     
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+    void draw(juce::Graphics& g, juce::Rectangle<int> area) const;
     
-    AnalyserPathGenerator<juce::Path> pathProducer;
-
-    juce::Path leftChannelFFTPath;
+    void clear();
+    
+private:
+    static constexpr int numColours = 256;
+    std::array<juce::PixelARGB, numColours> colourTable;
+    
+    juce::Image image;
+    //Row of the newest line
+    int newestLine = 0;
 };
 
 struct ResponseCurveComponent: juce::Component,
@@ -232,7 +393,7 @@ juce::Timer
 
     void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override {}
     
-    void timerCallback() override;
+    void timerCallback() override { onFrame(); }
     
     void paint(juce::Graphics& g) override;
     
@@ -241,30 +402,78 @@ juce::Timer
     void toggleAnalysisEnablement(bool enabled)
     {
         shouldShowFFTAnalysis = enabled;
+        updateAnalyserAttachment();
+        spectrogram.clear();
+        repaint(getRenderArea());
     }
     
+    void visibilityChanged() override { updateAnalyserAttachment(); }
+    void parentHierarchyChanged() override { updateAnalyserAttachment(); }
+    
 private:
+    //The analyser only reads the processor's tap while it is enabled and on screen
+    void updateAnalyserAttachment();
+    
     ZooEQAudioProcessor& audioProcessor;
     juce::Atomic<bool> parametersChanged { false };
     
-    MonoChain monoChain;
+    //Every active section of the chain, peak, low cut then high cut
+    std::array<BiquadCoefficients, 9> activeSections;
+    int numActiveSections = 0;
+    double chainSampleRate = 0;
     
     void updateChain();
     
+    //Only recomputed when the chain, the size or the sample rate change, paint just strokes it
+    BiquadResponseTable responseTable;
+    std::vector<double> responseDecibels;
+    juce::Path responseCurve;
+    
+    void updateResponseCurve();
+    
     juce::Image background;
     
     juce::Rectangle<int> getRenderArea();
     
     juce::Rectangle<int> getAnalysisArea();
     
-    PathProducer leftPathProducer, rightPathProducer;
+    PathProducer pathProducer;
+    juce::SharedResourcePointer<AnalysisThread> analysisThread;
+    std::atomic<float>* analyserResolution = nullptr;
+    std::atomic<float>* analyserChannels = nullptr;
+    std::atomic<float>* analyserMode = nullptr;
+    std::atomic<float>* analyserAveraging = nullptr;
+    std::atomic<float>* analyserOverlap = nullptr;
+    std::atomic<float>* analyserPeakHold = nullptr;
     
     bool shouldShowFFTAnalysis = true;
+    
+    SpectrogramImage spectrogram;
+    bool showSpectrogram = false;
+    bool showPeaks = false;
+    
+    //Only repaints what changed : new analyser data, a parameter edit or the sample rate
+    void onFrame();
+    
+   #if ZOOEQ_USE_VBLANK
+    std::unique_ptr<juce::VBlankAttachment> vBlankAttachment;
+   #endif
 };
 
 //==============================================================================
 
 struct PowerButton : juce::ToggleButton { };
+
+//Lists the choices of its parameter, before any attachment gets created
+struct ParameterChoiceBox : juce::ComboBox
+{
+    ParameterChoiceBox(juce::RangedAudioParameter& rap)
+    {
+        if ( auto* choiceParam = dynamic_cast<juce::AudioParameterChoice*>(&rap) )
+            addItemList(choiceParam->choices, 1);
+    }
+};
+
 struct AnalyserButton : juce::ToggleButton
 {
     void resized() override
@@ -322,6 +531,8 @@ private:
     
     PowerButton lowcutBypassButton, peakBypassButton, highcutBypassButton;
     AnalyserButton analyserEnableButton;
+    ParameterChoiceBox analyserResolutionBox, analyserChannelsBox, analyserModeBox, analyserAveragingBox;
+    juce::ToggleButton analyserPeakHoldButton { "Peak Hold" };
     
     
     using ButtonAttachment = APVTS::ButtonAttachment;
@@ -330,6 +541,19 @@ private:
                         highcutBypassButtonAttachment,
                         analyserEnableButtonAttachment;
     
+    APVTS::ComboBoxAttachment analyserResolutionBoxAttachment,
+                              analyserChannelsBoxAttachment,
+                              analyserModeBoxAttachment,
+                              analyserAveragingBoxAttachment;
+    APVTS::ButtonAttachment analyserPeakHoldButtonAttachment;
+    
+    //Long-term spectrum capture : started, stopped and exported from a menu, lit while it runs
+    juce::TextButton captureButton { "LTAS" };
+    std::unique_ptr<juce::FileChooser> exportChooser;
+    
+    void showCaptureMenu();
+    void exportCapture(bool asCSV);
+    
     std::vector<juce::Component*> getComps();
     
     LookAndFeel lnf;
@@ -7,7 +7,15 @@
 */
 
 #include "PluginProcessor.h"
-#include "PluginEditor.h"
+
+//Command line tools (ZooEQRender) define ZOOEQ_HEADLESS=1 to build the processor without its editor
+#ifndef ZOOEQ_HEADLESS
+ #define ZOOEQ_HEADLESS 0
+#endif
+
+#if ! ZOOEQ_HEADLESS
+ #include "PluginEditor.h"
+#endif
 
 //==============================================================================
 ZooEQAudioProcessor::ZooEQAudioProcessor()
@@ -22,10 +30,28 @@ ZooEQAudioProcessor::ZooEQAudioProcessor()
                        )
 #endif
 {
+    for ( auto* param : getParameters() )
+    {
+        param->addListener(this);
+    }
+    
+    analyserEnabled = apvts.getRawParameterValue("Analyser Enable");
+    
+    designThread->addClient(this);
+    analysisThread->addClient(&spectrumCapture);
 }
 
 ZooEQAudioProcessor::~ZooEQAudioProcessor()
 {
+    //Waits for the designer if it is currently working on this instance
+    designThread->removeClient(this);
+    //Same for the capture and the analysis thread
+    analysisThread->removeClient(&spectrumCapture);
+    
+    for ( auto* param : getParameters() )
+    {
+        param->removeListener(this);
+    }
 }
 
 //==============================================================================
@@ -104,15 +130,40 @@ void ZooEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
     
     spec.sampleRate=sampleRate;
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    //Every channel of the bus shares the same coefficients, only the filter states are per channel
+    filterEngine.prepare(getTotalNumOutputChannels(), samplesPerBlock);
+    filterEngine.reset();
     
     // === Filter Processing === //
-    updateFilters();
+    //The chains have just been reset and the sample rate may have changed : redesign every band
+    //and load them right away (the audio thread is not running during prepareToPlay)
+    designSampleRate = sampleRate;
+    designFilters(true);
+    
+    lowCutFreqRamp.reset(sampleRate, rampLengthSeconds);
+    highCutFreqRamp.reset(sampleRate, rampLengthSeconds);
+    peakFreqRamp.reset(sampleRate, rampLengthSeconds);
+    peakQualityRamp.reset(sampleRate, rampLengthSeconds);
+    peakGainRamp.reset(sampleRate, rampLengthSeconds);
+    samplesUntilRampUpdate = 0;
+    
+    appliedLowCutVersion = appliedPeakVersion = appliedHighCutVersion = -1;
+    updateFilters(false);
+    
+    //From now on automation may come on the audio thread, which never wakes the designer
+    designThread->setClientProcessing(this, true);
     
     // === Fifo process === //
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    {
+        //An open editor may be reading the analyser taps right now, and the capture reads its own
+        //taps even without an editor
+        const AnalysisThread::ScopedPause pause(*analysisThread);
+        leftChannelFifo.prepare(samplesPerBlock);
+        rightChannelFifo.prepare(samplesPerBlock);
+        leftCaptureFifo.prepare(samplesPerBlock, captureFifoCapacity);
+        rightCaptureFifo.prepare(samplesPerBlock, captureFifoCapacity);
+        spectrumCapture.setSampleRate(sampleRate);
+    }
     
     osc.initialise([](float x) { return std::sin(x); } );
     
@@ -126,6 +177,7 @@ void ZooEQAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    designThread->setClientProcessing(this, false);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -135,12 +187,11 @@ bool ZooEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) co
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout from mono up to third order ambisonics / 9.1.6 is accepted :
+    // the same EQ is applied to every channel.
+    const auto numChannels = layouts.getMainOutputChannelSet().size();
+    
+    if ( numChannels < 1 || numChannels > MultiChannelCascade::maxChannels )
         return false;
 
     // This checks if the input layout matches the output layout
@@ -154,7 +205,19 @@ bool ZooEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) co
 }
 #endif
 
-void ZooEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+void ZooEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    processSamples(buffer);
+}
+
+void ZooEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    //64 bit hosts : every section runs in double, no conversion on the way in or out
+    processSamples(buffer);
+}
+
+template<typename SampleType>
+void ZooEQAudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
@@ -170,34 +233,88 @@ void ZooEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::
         buffer.clear (i, 0, buffer.getNumSamples());
 
     // === Filter Processing === //
-    updateFilters();
+    //Picks up coefficients published by the designer thread, if any
+    updateFilters(true);
     
     // === Apply FX on the audio === //
-    juce::dsp::AudioBlock<float> block(buffer);
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    
+    const auto numSamples = (int)block.getNumSamples();
+    int startSample = 0;
+    
+    //While a band glides, split the block on the ramp grid and move the coefficients in between
+    while ( startSample < numSamples && isRampingFilters() )
+    {
+        if ( samplesUntilRampUpdate == 0 )
+        {
+            advanceFilterRamps(rampUpdateInterval);
+            samplesUntilRampUpdate = rampUpdateInterval;
+        }
+        
+        auto numToProcess = juce::jmin(numSamples - startSample, samplesUntilRampUpdate);
+        processChains(block.getSubBlock((size_t)startSample, (size_t)numToProcess));
+        
+        startSample += numToProcess;
+        samplesUntilRampUpdate -= numToProcess;
+    }
+    
+    //Steady state : the whole (remaining) block in one go
+    if ( startSample < numSamples )
+    {
+        samplesUntilRampUpdate = 0;
+        processChains(block.getSubBlock((size_t)startSample, (size_t)(numSamples - startSample)));
+    }
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    //The analyser tap only runs while an editor shows it
+    if ( analyserEnabled->load() > 0.5f )
+    {
+        if ( leftChannelFifo.hasConsumers() )
+            leftChannelFifo.update(buffer);
+        
+        if ( rightChannelFifo.hasConsumers() )
+            rightChannelFifo.update(buffer);
+    }
     
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    //The capture doesn't depend on the analyser being shown
+    if ( leftCaptureFifo.hasConsumers() )
+        leftCaptureFifo.update(buffer);
     
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    if ( rightCaptureFifo.hasConsumers() )
+        rightCaptureFifo.update(buffer);
+}
+
+template<typename SampleType>
+void ZooEQAudioProcessor::processChains(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    //Every active section runs in a single pass, over one channel or a SIMD group of channels
+    filterEngine.process(block);
+}
+
+void ZooEQAudioProcessor::parameterValueChanged(int parameterIndex, float newValue)
+{
+    //Can be called from any thread (host automation, GUI, state restore). Bumping the version
+    //is all the audio thread may do : the designer polls for it while this instance processes.
+    ++parametersVersion;
     
-    leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+    //Wakes the designer straight away for the GUI, notify() locks so never from the audio thread
+    if ( juce::MessageManager::existsAndIsCurrentThread() )
+        designThread->notify();
 }
 
 //==============================================================================
 bool ZooEQAudioProcessor::hasEditor() const
 {
-    return true; // (change this to false if you choose to not supply an editor)
+    return ! ZOOEQ_HEADLESS; // (change this to false if you choose to not supply an editor)
 }
 
 juce::AudioProcessorEditor* ZooEQAudioProcessor::createEditor()
 {
+   #if ZOOEQ_HEADLESS
+    return nullptr;
+   #else
     return new ZooEQAudioProcessorEditor (*this);
 //    return new juce::GenericAudioProcessorEditor(*this);
+   #endif
 }
 
 //==============================================================================
@@ -222,8 +339,10 @@ void ZooEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes
     auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
     if ( tree.isValid() )
     {
+        //The parameter listeners hand the new values to the designer thread,
+        //the chains themselves are only ever touched by the audio thread
         apvts.replaceState(tree);
-        updateFilters();
+        designThread->notify();
     }
 }
 
@@ -245,72 +364,614 @@ ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
     return settings;
 }
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
+static BiquadCoefficients makeBiquad(double b0, double b1, double b2, double a0, double a1, double a2)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.peakFreq,
-                                                               chainSettings.peakQuality,
-                                                               juce::Decibels::decibelsToGain(chainSettings.peakGainInDecibels));
+    auto a0inv = 1.0 / a0;
+    
+    return { b0 * a0inv, b1 * a0inv, b2 * a0inv, a1 * a0inv, a2 * a0inv };
 }
 
-void ZooEQAudioProcessor::updatePeakFilter(const ChainSettings& chainSettings)
+BiquadCoefficients makePeakBiquad(const ChainSettings& chainSettings, double sampleRate)
 {
-    //Read if filter is bypassed
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
+    //Same maths as juce::dsp::IIR::Coefficients::makePeakFilter
+    auto gainFactor = juce::Decibels::decibelsToGain((double)chainSettings.peakGainInDecibels);
+    auto A = std::sqrt(juce::jmax(0.0, gainFactor));
+    auto omega = (juce::MathConstants<double>::twoPi * juce::jmax((double)chainSettings.peakFreq, 2.0)) / sampleRate;
+    auto alpha = std::sin(omega) / (chainSettings.peakQuality * 2.0);
+    auto c2 = -2.0 * std::cos(omega);
+    auto alphaTimesA = alpha * A;
+    auto alphaOverA = alpha / A;
     
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    return makeBiquad(1.0 + alphaTimesA, c2, 1.0 - alphaTimesA,
+                      1.0 + alphaOverA, c2, 1.0 - alphaOverA);
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements)
+//Below fs / 200 (220Hz at 44.1kHz, 960Hz at 192kHz) the poles of a cut sit so close to z = 1 that
+//float coefficients and state audibly lose precision : those sections run in double instead.
+//A band only goes back to float above fs / 160, so a cutoff sitting on the threshold doesn't keep switching.
+constexpr double highPrecisionCutoffRatio = 1.0 / 200.0;
+constexpr double highPrecisionReleaseRatio = 1.0 / 160.0;
+
+static CutCoefficients makeCutCoefficients(float frequency, Slope slope, bool bypassed, bool isHighPass,
+                                           double sampleRate, bool wasHighPrecision)
 {
-    *old = *replacements;
+    //Same maths as juce::dsp::FilterDesign::designIIR...HighOrderButterworthMethod for even orders :
+    //one biquad per 12dB/Oct, each with its own Butterworth Q, the sections above the slope stay bypassed
+    CutCoefficients cut;
+    cut.slope = slope;
+    cut.bypassed = bypassed;
+    cut.highPrecision = frequency < sampleRate * (wasHighPrecision ? highPrecisionReleaseRatio : highPrecisionCutoffRatio);
+    
+    const auto order = 2 * (slope + 1);
+    const auto n = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    
+    for ( int i = 0; i < order / 2; ++i )
+    {
+        auto Q = 1.0 / (2.0 * std::cos((2.0 * i + 1.0) * juce::MathConstants<double>::pi / (order * 2.0)));
+        auto invQ = 1.0 / Q;
+        
+        if ( isHighPass )
+        {
+            auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+            cut.sections[i] = makeBiquad(c1, c1 * -2.0, c1,
+                                         1.0, c1 * 2.0 * (nSquared - 1.0), c1 * (1.0 - invQ * n + nSquared));
+        }
+        else
+        {
+            auto m = 1.0 / n;
+            auto mSquared = m * m;
+            auto c1 = 1.0 / (1.0 + invQ * m + mSquared);
+            cut.sections[i] = makeBiquad(c1, c1 * 2.0, c1,
+                                         1.0, c1 * 2.0 * (1.0 - mSquared), c1 * (1.0 - invQ * m + mSquared));
+        }
+    }
+    
+    return cut;
 }
 
-void ZooEQAudioProcessor::updateLowCutFilters(const ChainSettings &chainSettings)
+CutCoefficients makeLowCutCoefficients(const ChainSettings& chainSettings, double sampleRate, bool wasHighPrecision)
 {
-    //Read if filter is bypassed
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    return makeCutCoefficients(chainSettings.lowCutFreq,
+                               chainSettings.lowCutSlope,
+                               chainSettings.lowCutBypassed,
+                               true,
+                               sampleRate,
+                               wasHighPrecision);
+}
+
+CutCoefficients makeHighCutCoefficients(const ChainSettings& chainSettings, double sampleRate, bool wasHighPrecision)
+{
+    return makeCutCoefficients(chainSettings.highCutFreq,
+                               chainSettings.highCutSlope,
+                               chainSettings.highCutBypassed,
+                               false,
+                               sampleRate,
+                               wasHighPrecision);
+}
+
+//Cuts from this slope on go through the pipelined kernel, see BiquadCascade
+constexpr Slope minPipelinedSlope = Slope::Slope_24;
+
+static void loadCutFilter(BiquadCascade& cascade, int firstSection, const CutCoefficients& cut)
+{
+    CascadeBand<4> band(cascade, firstSection);
+    updateCutFilter(band, cut.sections, cut.slope);
     
-    //Definition of the low cut filter coefficients
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
+    for ( int i = 0; i < 4; ++i )
+        cascade.setSectionHighPrecision(firstSection + i, cut.highPrecision);
     
-    //Set the LowCut Filter Coeffecients to the left chain
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    updateCutFilter(leftLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+    //A lone 12dB/Oct section has nothing to overlap with, it stays with the serial sections
+    cascade.setBandPipelined(firstSection, 4, cut.slope >= minPipelinedSlope);
     
-    //Set the LowCut Filter Coeffecients to the right chain
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
-    updateCutFilter(rightLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+    //A bypassed band simply has all of its sections bypassed
+    if ( cut.bypassed )
+    {
+        band.setBypassed<0>(true);
+        band.setBypassed<1>(true);
+        band.setBypassed<2>(true);
+        band.setBypassed<3>(true);
+    }
 }
 
-void ZooEQAudioProcessor::updateHighCutFilter(const ChainSettings &chainSettings)
+void ZooEQAudioProcessor::updatePeakFilter(const BiquadCoefficients& peakCoefficients, bool bypassed)
 {
     //Read if filter is bypassed
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    filterEngine.cascade.setSectionBypassed(CascadePositions::PeakSection, bypassed);
+    filterEngine.cascade.getSection(CascadePositions::PeakSection).coefficients = peakCoefficients;
+}
+
+void ZooEQAudioProcessor::updateLowCutFilters(const CutCoefficients& lowCut)
+{
+    loadCutFilter(filterEngine.cascade, CascadePositions::LowCutSections, lowCut);
+}
+
+void ZooEQAudioProcessor::updateHighCutFilter(const CutCoefficients& highCut)
+{
+    loadCutFilter(filterEngine.cascade, CascadePositions::HighCutSections, highCut);
+}
+
+void ZooEQAudioProcessor::updateFilters(bool allowRamps)
+{
+    //Audio thread : never allocates, never locks
+    if ( ! coefficientSets.acquire() )
+        return;
+    
+    const auto& coefficientSet = coefficientSets.getReadBuffer();
+    const auto& target = coefficientSet.settings;
+    
+    //A frequency/gain/quality move glides on the ramp grid.
+    //A slope change or a bypass toggle can't be interpolated, it jumps straight to the new coefficients.
+    if ( coefficientSet.lowCutVersion != appliedLowCutVersion )
+    {
+        bool glide = allowRamps
+                  && ! target.lowCutBypassed
+                  && ! appliedSettings.lowCutBypassed
+                  && target.lowCutSlope == appliedSettings.lowCutSlope;
+        
+        if ( glide )
+        {
+            lowCutFreqRamp.setTargetValue(target.lowCutFreq);
+            lowCutRampHighPrecision = filterEngine.cascade.isSectionHighPrecision(CascadePositions::LowCutSections)
+                                   || coefficientSet.lowCut.highPrecision;
+        }
+        else
+        {
+            lowCutFreqRamp.setCurrentAndTargetValue(target.lowCutFreq);
+            updateLowCutFilters(coefficientSet.lowCut);
+        }
+        
+        appliedSettings.lowCutFreq = target.lowCutFreq;
+        appliedSettings.lowCutSlope = target.lowCutSlope;
+        appliedSettings.lowCutBypassed = target.lowCutBypassed;
+        appliedLowCutVersion = coefficientSet.lowCutVersion;
+    }
+    
+    if ( coefficientSet.peakVersion != appliedPeakVersion )
+    {
+        bool glide = allowRamps
+                  && ! target.peakBypassed
+                  && ! appliedSettings.peakBypassed;
+        
+        if ( glide )
+        {
+            peakFreqRamp.setTargetValue(target.peakFreq);
+            peakQualityRamp.setTargetValue(target.peakQuality);
+            peakGainRamp.setTargetValue(target.peakGainInDecibels);
+        }
+        else
+        {
+            peakFreqRamp.setCurrentAndTargetValue(target.peakFreq);
+            peakQualityRamp.setCurrentAndTargetValue(target.peakQuality);
+            peakGainRamp.setCurrentAndTargetValue(target.peakGainInDecibels);
+            updatePeakFilter(coefficientSet.peak, coefficientSet.peakBypassed);
+        }
+        
+        appliedSettings.peakFreq = target.peakFreq;
+        appliedSettings.peakQuality = target.peakQuality;
+        appliedSettings.peakGainInDecibels = target.peakGainInDecibels;
+        appliedSettings.peakBypassed = target.peakBypassed;
+        appliedPeakVersion = coefficientSet.peakVersion;
+    }
+    
+    if ( coefficientSet.highCutVersion != appliedHighCutVersion )
+    {
+        bool glide = allowRamps
+                  && ! target.highCutBypassed
+                  && ! appliedSettings.highCutBypassed
+                  && target.highCutSlope == appliedSettings.highCutSlope;
+        
+        if ( glide )
+        {
+            highCutFreqRamp.setTargetValue(target.highCutFreq);
+            highCutRampHighPrecision = filterEngine.cascade.isSectionHighPrecision(CascadePositions::HighCutSections)
+                                    || coefficientSet.highCut.highPrecision;
+        }
+        else
+        {
+            highCutFreqRamp.setCurrentAndTargetValue(target.highCutFreq);
+            updateHighCutFilter(coefficientSet.highCut);
+        }
+        
+        appliedSettings.highCutFreq = target.highCutFreq;
+        appliedSettings.highCutSlope = target.highCutSlope;
+        appliedSettings.highCutBypassed = target.highCutBypassed;
+        appliedHighCutVersion = coefficientSet.highCutVersion;
+    }
+}
+
+bool ZooEQAudioProcessor::isRampingFilters() const
+{
+    return lowCutFreqRamp.isSmoothing()
+        || highCutFreqRamp.isSmoothing()
+        || peakFreqRamp.isSmoothing()
+        || peakQualityRamp.isSmoothing()
+        || peakGainRamp.isSmoothing();
+}
+
+void ZooEQAudioProcessor::advanceFilterRamps(int numSamples)
+{
+    //Only the gliding bands are redesigned. Once a cut reaches its target it loads the coefficients
+    //the designer thread published for it, along with their precision.
+    auto sampleRate = getSampleRate();
+    auto rampSettings = appliedSettings;
+    const auto& target = coefficientSets.getReadBuffer();
+    
+    if ( lowCutFreqRamp.isSmoothing() )
+    {
+        rampSettings.lowCutFreq = lowCutFreqRamp.skip(numSamples);
+        
+        if ( lowCutFreqRamp.isSmoothing() )
+        {
+            auto lowCut = makeLowCutCoefficients(rampSettings, sampleRate);
+            lowCut.highPrecision = lowCutRampHighPrecision;
+            updateLowCutFilters(lowCut);
+        }
+        else
+        {
+            updateLowCutFilters(target.lowCut);
+        }
+    }
+    
+    if ( peakFreqRamp.isSmoothing() || peakQualityRamp.isSmoothing() || peakGainRamp.isSmoothing() )
+    {
+        rampSettings.peakFreq = peakFreqRamp.skip(numSamples);
+        rampSettings.peakQuality = peakQualityRamp.skip(numSamples);
+        rampSettings.peakGainInDecibels = peakGainRamp.skip(numSamples);
+        updatePeakFilter(makePeakBiquad(rampSettings, sampleRate), rampSettings.peakBypassed);
+    }
+    
+    if ( highCutFreqRamp.isSmoothing() )
+    {
+        rampSettings.highCutFreq = highCutFreqRamp.skip(numSamples);
+        
+        if ( highCutFreqRamp.isSmoothing() )
+        {
+            auto highCut = makeHighCutCoefficients(rampSettings, sampleRate);
+            highCut.highPrecision = highCutRampHighPrecision;
+            updateHighCutFilter(highCut);
+        }
+        else
+        {
+            updateHighCutFilter(target.highCut);
+        }
+    }
+}
+
+void ZooEQAudioProcessor::designFilters(bool forceUpdate)
+{
+    //Shared by the designer thread, prepareToPlay and setStateInformation, never by the audio thread
+    const juce::ScopedLock sl(designLock);
+    
+    auto sampleRate = designSampleRate.get();
+    
+    //Not prepared yet
+    if ( sampleRate <= 0.0 )
+        return;
+    
+    //A new sample rate invalidates every band
+    if ( sampleRate != lastSampleRate )
+    {
+        lastSampleRate = sampleRate;
+        forceUpdate = true;
+    }
+    
+    auto version = parametersVersion.get();
+    if ( ! forceUpdate && version == lastParametersVersion )
+        return;
+    
+    lastParametersVersion = version;
+    
+    auto chainSettings = getChainSettings(apvts);
+    bool changed = forceUpdate;
+    
+    //Only redesign the bands whose own parameters changed
+    if ( forceUpdate || ! chainSettings.lowCutMatches(lastChainSettings) )
+    {
+        designedCoefficients.lowCut = makeLowCutCoefficients(chainSettings, sampleRate, designedCoefficients.lowCut.highPrecision);
+        ++designedCoefficients.lowCutVersion;
+        changed = true;
+    }
     
-    //Definition of the high cut filter coefficients
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
+    if ( forceUpdate || ! chainSettings.peakMatches(lastChainSettings) )
+    {
+        designedCoefficients.peak = makePeakBiquad(chainSettings, sampleRate);
+        designedCoefficients.peakBypassed = chainSettings.peakBypassed;
+        ++designedCoefficients.peakVersion;
+        changed = true;
+    }
+    
+    if ( forceUpdate || ! chainSettings.highCutMatches(lastChainSettings) )
+    {
+        designedCoefficients.highCut = makeHighCutCoefficients(chainSettings, sampleRate, designedCoefficients.highCut.highPrecision);
+        ++designedCoefficients.highCutVersion;
+        changed = true;
+    }
+    
+    lastChainSettings = chainSettings;
+    designedCoefficients.settings = chainSettings;
+    
+    //Hand the whole set over to the audio thread
+    if ( changed )
+    {
+        coefficientSets.getWriteBuffer() = designedCoefficients;
+        coefficientSets.publish();
+    }
+}
+
+//==============================================================================
+FilterDesignThread::FilterDesignThread() : juce::Thread("ZooEQ Filter Designer")
+{
+    startThread();
+}
+
+FilterDesignThread::~FilterDesignThread()
+{
+    stopThread(1000);
+}
+
+void FilterDesignThread::addClient(FilterDesignClient* client)
+{
+    const juce::ScopedLock sl(clientsLock);
+    clients.addIfNotAlreadyThere(client);
+}
+
+void FilterDesignThread::removeClient(FilterDesignClient* client)
+{
+    {
+        const juce::ScopedLock sl(clientsLock);
+        clients.removeFirstMatchingValue(client);
+        processingClients.removeFirstMatchingValue(client);
+    }
+    
+    //Once the designer lets go of this lock it can't pick the client up any more
+    const juce::ScopedLock sl(designLock);
+}
+
+void FilterDesignThread::setClientProcessing(FilterDesignClient* client, bool isProcessing)
+{
+    {
+        const juce::ScopedLock sl(clientsLock);
+        
+        if ( isProcessing )
+            processingClients.addIfNotAlreadyThere(client);
+        else
+            processingClients.removeFirstMatchingValue(client);
+    }
+    
+    //Switches the wait below between polling and sleeping
+    notify();
+}
+
+void FilterDesignThread::run()
+{
+    auto isStillAClient = [this](FilterDesignClient* client)
+    {
+        const juce::ScopedLock sl(clientsLock);
+        return clients.contains(client);
+    };
     
-    //Set the HighCut Filter Coeffecients to the left chain
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    while ( ! threadShouldExit() )
+    {
+        {
+            const juce::ScopedLock sl(clientsLock);
+            clientsToDesign = clients;
+        }
+        
+        for ( auto* client : clientsToDesign )
+        {
+            const juce::ScopedLock sl(designLock);
+            
+            //Removed since the copy was made
+            if ( isStillAClient(client) )
+                client->designFilters(false);
+        }
+        
+        bool polling;
+        
+        {
+            const juce::ScopedLock sl(clientsLock);
+            polling = ! processingClients.isEmpty();
+        }
+        
+        //Until a client has something new. A notify() that came in during the pass
+        //above is not lost, it ends this wait straight away. Changes from the audio
+        //thread never notify(), they are picked up by polling while a client processes.
+        wait(polling ? automationPollIntervalMs : -1);
+    }
+}
+
+//==============================================================================
+AnalysisThread::AnalysisThread() : juce::Thread("ZooEQ Analyser")
+{
+    startThread();
+}
+
+AnalysisThread::~AnalysisThread()
+{
+    stopThread(1000);
+}
+
+void AnalysisThread::addClient(AnalysisClient* client)
+{
+    const juce::ScopedLock sl(clientsLock);
+    clients.addIfNotAlreadyThere(client);
+}
+
+void AnalysisThread::removeClient(AnalysisClient* client)
+{
+    {
+        const juce::ScopedLock sl(clientsLock);
+        clients.removeFirstMatchingValue(client);
+    }
     
-    //Set the HighCut Filter Coeffecients to the right chain
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    //The thread only starts on a client under clientsLock, once it lets go of this lock
+    //it can't pick the client up any more. Other clients being analysed don't hold it.
+    const juce::ScopedLock sl(client->analysisLock);
 }
 
-void ZooEQAudioProcessor::updateFilters()
+void AnalysisThread::requestAnalysis(AnalysisClient* client)
 {
-    auto chainSettigns = getChainSettings(apvts);
-    updateLowCutFilters(chainSettigns);
-    updatePeakFilter(chainSettigns);
-    updateHighCutFilter(chainSettigns);
+    client->analysisRequested = true;
+    notify();
+}
+
+void AnalysisThread::run()
+{
+    auto nextIdlePass = juce::Time::getMillisecondCounter();
+    
+    while ( ! threadShouldExit() )
+    {
+        //Wraps around like the counter, hence the signed difference
+        const auto isIdlePass = (int)(juce::Time::getMillisecondCounter() - nextIdlePass) >= 0;
+        
+        if ( isIdlePass )
+            nextIdlePass = juce::Time::getMillisecondCounter() + (juce::uint32)idleIntervalMs;
+        
+        {
+            const juce::ScopedLock sl(clientsLock);
+            clientsToAnalyse = clients;
+        }
+        
+        for ( auto* client : clientsToAnalyse )
+        {
+            const juce::ScopedLock paused(pauseLock);
+            
+            {
+                const juce::ScopedLock sl(clientsLock);
+                
+                //Removed since the copy was made
+                if ( ! clients.contains(client) )
+                    continue;
+                
+                client->analysisLock.enter();
+            }
+            
+            //Cleared before running : a request made during runAnalysis() gets a pass of its own
+            if ( client->analysisRequested.exchange(false) || isIdlePass )
+                client->runAnalysis();
+            
+            client->analysisLock.exit();
+        }
+        
+        //A requestAnalysis() that came in during the pass ends this wait straight away
+        wait(juce::jmax(1, (int)(nextIdlePass - juce::Time::getMillisecondCounter())));
+    }
+}
+
+//==============================================================================
+SpectrumCapture::SpectrumCapture(ChannelFifo& leftFifo, ChannelFifo& rightFifo) :
+channelFifos { &leftFifo, &rightFifo }
+{
+    for ( auto& buffer : scratch )
+        buffer.resize((size_t)scratchSize);
+}
+
+SpectrumCapture::~SpectrumCapture()
+{
+    stop();
+}
+
+void SpectrumCapture::start()
+{
+    //The analysis thread drops what is left from before and starts the average over
+    resetPending = true;
+    
+    if ( capturing.exchange(true) )
+        return;
+    
+    for ( auto* fifo : channelFifos )
+        fifo->addConsumer();
+}
+
+void SpectrumCapture::stop()
+{
+    if ( ! capturing.exchange(false) )
+        return;
+    
+    for ( auto* fifo : channelFifos )
+        fifo->removeConsumer();
+}
+
+double SpectrumCapture::getSecondsCaptured() const
+{
+    const juce::ScopedLock sl(spectrumLock);
+    return spectrum.getSecondsAnalysed();
+}
+
+template<typename WriteFunction>
+bool SpectrumCapture::exportTo(const juce::File& file, WriteFunction&& write) const
+{
+    //Formatted in memory, the analysis thread only waits for that and not for the disk
+    juce::MemoryBlock data;
+    
+    {
+        const juce::ScopedLock sl(spectrumLock);
+        
+        if ( spectrum.getNumFrames() == 0 )
+            return false;
+        
+        juce::MemoryOutputStream out(data, false);
+        write(out);
+    }
+    
+    return file.replaceWithData(data.getData(), data.getSize());
+}
+
+bool SpectrumCapture::exportCSV(const juce::File& file) const
+{
+    return exportTo(file, [this](juce::OutputStream& out) { spectrum.writeCSV(out); });
+}
+
+bool SpectrumCapture::exportBinary(const juce::File& file) const
+{
+    return exportTo(file, [this](juce::OutputStream& out) { spectrum.writeBinary(out); });
+}
+
+void SpectrumCapture::runAnalysis()
+{
+    if ( ! capturing )
+        return;
+    
+    const auto currentSampleRate = sampleRate.load();
+    
+    //Not prepared yet
+    if ( currentSampleRate <= 0 )
+        return;
+    
+    const juce::ScopedLock sl(spectrumLock);
+    
+    //Averaging across two sample rates means nothing : a new one starts over
+    if ( spectrum.getSampleRate() != currentSampleRate )
+    {
+        spectrum.prepare(currentSampleRate);
+        resetPending = true;
+    }
+    
+    if ( resetPending.exchange(false) )
+    {
+        for ( auto* fifo : channelFifos )
+            fifo->discardAvailable();
+        
+        spectrum.reset();
+    }
+    
+    //Only what both channels have, so that the frames stay in step
+    auto left = channelFifos[0]->getAvailableSamples();
+    auto right = channelFifos[1]->getAvailableSamples();
+    auto numSamples = juce::jmin(left.getNumSamples(), right.getNumSamples());
+    
+    for ( int start = 0; start < numSamples; start += scratchSize )
+    {
+        auto numToCopy = juce::jmin(scratchSize, numSamples - start);
+        
+        left.copy(scratch[0].data(), start, numToCopy);
+        right.copy(scratch[1].data(), start, numToCopy);
+        spectrum.push(scratch[0].data(), scratch[1].data(), numToCopy);
+    }
+    
+    for ( auto* fifo : channelFifos )
+        fifo->finishedRead(numSamples);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout
@@ -356,6 +1017,37 @@ juce::AudioProcessorValueTreeState::ParameterLayout
     layout.add(std::make_unique<juce::AudioParameterBool>("Peak Bypassed", "Peak Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("HighCut Bypassed", "HighCut Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("Analyser Enable", "Analyser Enable", true));
+    
+    //FFT sizes, in the same order as FFTOrder, then the octave band analyser
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyser Resolution",
+                                                            "Analyser Resolution",
+                                                            juce::StringArray { "2048", "4096", "8192", "Multirate" },
+                                                            0));
+    
+    //In the same order as StereoView
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyser Channels",
+                                                            "Analyser Channels",
+                                                            juce::StringArray { "Left/Right", "Mid/Side" },
+                                                            0));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyser Mode",
+                                                            "Analyser Mode",
+                                                            juce::StringArray { "Curves", "Spectrogram" },
+                                                            0));
+    
+    //In the same order as SpectrumAveraging
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyser Averaging",
+                                                            "Analyser Averaging",
+                                                            juce::StringArray { "Raw", "Average", "Ballistics" },
+                                                            0));
+    
+    //FFT frames per FFT length, 2 << index : the hop is fftSize / overlap
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyser Overlap",
+                                                            "Analyser Overlap",
+                                                            juce::StringArray { "2x", "4x", "8x", "16x" },
+                                                            1));
+    
+    layout.add(std::make_unique<juce::AudioParameterBool>("Analyser Peak Hold", "Analyser Peak Hold", false));
  
     return layout;
 }
@@ -10,70 +10,47 @@
 
 #include <JuceHeader.h>
 #include <array>
+#include "BiquadCascade.h"
+#include "SampleRing.h"
+#include "Fifo.h"
+#include "LongTermSpectrum.h"
 
+/**
+    Wait-free single producer / single consumer handoff of the latest value.
+    The producer fills getWriteBuffer() then publish()es it, the consumer
+    acquire()s and reads getReadBuffer(). Values the consumer never got to are
+    simply overwritten, nothing is ever allocated or freed after construction.
+ */
 template<typename T>
-struct Fifo
+struct TripleBuffer
 {
-    void prepare(int numChannels, int numSamples)
-    {
-        static_assert(std::is_same_v<T, juce::AudioBuffer<float>>,
-                      "prepare(numChannels, numSamples) should only be use when the fifo is holding std::AudioBuffer<float>");
-        
-        for (auto& buffer : buffers)
-        {
-            buffer.setSize(numChannels,
-                           numSamples,
-                           false,       //clear everything ?
-                           true,        //including the extra space ?
-                           true);       //avoid reallocation if you can ?
-            buffer.clear();
-        }
-    }
+    //Producer side
+    T& getWriteBuffer() { return buffers[writeIndex]; }
     
-    void prepare(size_t numElements)
+    void publish()
     {
-        static_assert(std::is_same_v<T, std::vector<float>>,
-                      "prepare(numElements) should only be use when the fifo is holding std::vector<float>");
-        
-        for ( auto& buffer : buffers )
-        {
-            buffer.clear();
-            buffer.resize(numElements, 0);
-        }
-        
-    }
-    
-    bool push(const T& t)
-    {
-        auto write = fifo.write(1);
-        if(write.blockSize1 > 0)
-        {
-            buffers[write.startIndex1] = t;
-            return true;
-        }
-        return false;
+        writeIndex = state.exchange(writeIndex | dirtyFlag) & indexMask;
     }
     
-    bool pull(T& t)
+    //Consumer side, returns false when nothing new has been published since the last call
+    bool acquire()
     {
-        auto read = fifo.read(1);
-        if(read.blockSize1 > 0)
-        {
-            t = buffers[read.startIndex1];
-            return true;
-        }
-        return false;
+        if ( (state.get() & dirtyFlag) == 0 )
+            return false;
+        
+        readIndex = state.exchange(readIndex) & indexMask;
+        return true;
     }
     
-    int getNumAvailableForReading() const
-    {
-        return fifo.getNumReady();
-    }
+    const T& getReadBuffer() const { return buffers[readIndex]; }
     
 private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo {Capacity};
+    static constexpr int indexMask = 3;
+    static constexpr int dirtyFlag = 4;
+    
+    std::array<T, 3> buffers;
+    int writeIndex = 0, readIndex = 1;
+    juce::Atomic<int> state { 2 };
 };
 
 enum Channel
@@ -90,62 +67,77 @@ struct SingleChannelSampleFifo
         prepared.set(false);
     }
     
-    void update(const BlockType& buffer)
+    //Also takes double buffers, the analysers always work in float
+    template<typename BufferType>
+    void update(const BufferType& buffer)
     {
         jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse);
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        jassert(buffer.getNumChannels() > 0);
         
-        for ( int i = 0; i < buffer.getNumSamples(); ++i )
-        {
-            pushNextSampleIntoFifo(channelPtr[i]);
-        }
+        //On a mono bus both analysers look at the only channel there is
+        auto* channelPtr = buffer.getReadPointer(juce::jmin((int)channelToUse, buffer.getNumChannels() - 1));
+        
+        //The whole block in one or two copies, whatever its size compared to the prepared one
+        auto numSamples = buffer.getNumSamples();
+        auto written = ring.write(channelPtr, numSamples);
+        
+        telemetry.recordWrite(written, numSamples, ring.getNumReady());
     }
     
-    void prepare(int bufferSize)
+    //capacity : samples the ring holds at least, above the default.
+    //Not thread safe : the analysis thread reads the ring, hold an AnalysisThread::ScopedPause.
+    void prepare(int bufferSize, int capacity = 0)
     {
         prepared.set(false);
         size.set(bufferSize);
         
-        bufferToFill.setSize(1,             //Channel
-                             bufferSize,    //Num Sample
-                             false,         //KeepExistingContent
-                             true,          //Clear extra space
-                             true);         //avoid reallocating
-        
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
+        //Room for many blocks : the analyser only runs at the display rate
+        ring.prepare(juce::jmax(bufferSize * 16, minimumCapacity, capacity));
+        telemetry.reset();
         prepared.set(true);
     }
     
     //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
+    int getNumCompleteBuffersAvailable() const { return ring.getNumReady() / juce::jmax(1, size.get()); }
+    int getNumSamplesAvailable() const { return ring.getNumReady(); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
+    //In samples : a growing numDropped means the analyser can't keep up
+    FifoStatistics getStatistics() const { return telemetry.get(); }
     //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
-private:
-    Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
-    juce::Atomic<bool> prepared = false;
-    juce::Atomic<int> size = 0;
+    //Analysers register while they display this channel, without any the audio thread skips the tap
+    void addConsumer() { ++numConsumers; }
+    void removeConsumer() { --numConsumers; }
+    bool hasConsumers() const { return numConsumers.load(std::memory_order_relaxed) > 0; }
+    //Consumer side : drops everything written so far, for a clean start after (re)attaching
+    void discardAvailable() { ring.finishedRead(ring.getNumReady()); }
+    //==============================================================================
+    //Zero copy access to the next getSize() samples, release them with finishedRead()
+    SampleRing::ReadSpan getNextBuffer() const { return ring.getReadSpan(size.get()); }
+    //Everything written so far, whatever the host's block size
+    SampleRing::ReadSpan getAvailableSamples() const { return ring.getReadSpan(ring.getNumReady()); }
+    void finishedRead(int numSamples) { ring.finishedRead(numSamples); }
     
-    void pushNextSampleIntoFifo(float sample)
+    bool getAudioBuffer(BlockType& buf)
     {
-        if ( fifoIndex == bufferToFill.getNumSamples() )
-        {
-            auto ok = audioBufferFifo.push(bufferToFill);
-            
-            juce::ignoreUnused(ok);
-            
-            fifoIndex = 0;
-        }
+        if ( getNumCompleteBuffersAvailable() == 0 )
+            return false;
         
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
+        auto span = getNextBuffer();
+        buf.setSize(1, span.getNumSamples(), false, false, true);
+        span.copyLast(buf.getWritePointer(0), span.getNumSamples());
+        finishedRead(span.getNumSamples());
+        return true;
     }
+private:
+    static constexpr int minimumCapacity = 1 << 15;
+    
+    Channel channelToUse;
+    SampleRing ring;
+    FifoTelemetry telemetry;
+    std::atomic<int> numConsumers { 0 };
+    juce::Atomic<bool> prepared = false;
+    juce::Atomic<int> size = 0;
 };
 
 enum Slope
@@ -162,28 +154,47 @@ struct ChainSettings
     float lowCutFreq{0}, highCutFreq{0};
     Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
     bool lowCutBypassed { false }, peakBypassed { false }, highCutBypassed { false };
+    
+    //Per-band comparisons : a band only needs new coefficients when one of its own values moved
+    bool lowCutMatches(const ChainSettings& other) const
+    {
+        return lowCutFreq == other.lowCutFreq
+            && lowCutSlope == other.lowCutSlope
+            && lowCutBypassed == other.lowCutBypassed;
+    }
+    
+    bool peakMatches(const ChainSettings& other) const
+    {
+        return peakFreq == other.peakFreq
+            && peakGainInDecibels == other.peakGainInDecibels
+            && peakQuality == other.peakQuality
+            && peakBypassed == other.peakBypassed;
+    }
+    
+    bool highCutMatches(const ChainSettings& other) const
+    {
+        return highCutFreq == other.highCutFreq
+            && highCutSlope == other.highCutSlope
+            && highCutBypassed == other.highCutBypassed;
+    }
 };
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
-using Filter = juce::dsp::IIR::Filter<float>;
-
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
-
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+//Lets updateCutFilter() load plain coefficients into a CascadeBand
+inline void updateCoefficients(BiquadCoefficients& old, const BiquadCoefficients& replacements)
+{
+    old = replacements;
+}
 
-enum ChainPositions
+//Where the bands live inside the BiquadCascade
+enum CascadePositions
 {
-    LowCut,
-    Peak,
-    HighCut
+    LowCutSections = 0,
+    PeakSection = 4,
+    HighCutSections = 5
 };
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients(Coefficients& old, const Coefficients& replacements);
-
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate);
-
 template<int Index, typename ChainType, typename CoefficientType>
 void update(ChainType& chain, CoefficientType& cutCoefficients)
 {
@@ -222,26 +233,199 @@ void updateCutFilter(ChainType& chain,
     }
 }
 
-inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate)
+struct CutCoefficients
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
-                                                                                       sampleRate,
-                                                                                       2 *(chainSettings.lowCutSlope + 1));
-    //For the order parameter, it is changing the slope choice (0/1/2/3) in filter order (2/4/6/8)
-}
+    std::array<BiquadCoefficients, 4> sections;
+    Slope slope { Slope::Slope_12 };
+    bool bypassed { false };
+    
+    //Cutoff low enough relative to the sample rate for float sections to add audible noise
+    bool highPrecision { false };
+};
 
-inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
+//Closed form designs giving the same coefficients as juce::dsp::IIR::Coefficients::makePeakFilter and
+//juce::dsp::FilterDesign's Butterworth cuts. They never allocate, so the audio thread can also use
+//them while a band glides.
+BiquadCoefficients makePeakBiquad(const ChainSettings& chainSettings, double sampleRate);
+//wasHighPrecision is the precision the band had so far, the threshold has some hysteresis around it.
+CutCoefficients makeLowCutCoefficients(const ChainSettings& chainSettings, double sampleRate, bool wasHighPrecision = false);
+CutCoefficients makeHighCutCoefficients(const ChainSettings& chainSettings, double sampleRate, bool wasHighPrecision = false);
+
+//Every coefficient of the chain, designed off the audio thread and handed over in one go
+struct FilterCoefficientSet
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
-                                                                                      sampleRate,
-                                                                                      2 *(chainSettings.highCutSlope + 1));
-    //For the order parameter, it is changing the slope choice (0/1/2/3) in filter order (2/4/6/8)
-}
+    CutCoefficients lowCut, highCut;
+    BiquadCoefficients peak;
+    bool peakBypassed { false };
+    
+    //The values the set was designed from, the audio thread glides towards them
+    ChainSettings settings;
+    
+    //Bumped each time a band is redesigned, the audio thread only applies the bands that moved
+    int lowCutVersion { 0 }, peakVersion { 0 }, highCutVersion { 0 };
+};
+
+//==============================================================================
+struct FilterDesignClient
+{
+    virtual ~FilterDesignClient() = default;
+    
+    //Called on the designer thread, must never be called from the audio thread
+    virtual void designFilters(bool forceUpdate) = 0;
+};
+
+/**
+    Background thread shared by every ZooEQ instance, so that coefficient design (which
+    allocates) never happens on the audio thread. It sleeps until a client notify()s it
+    after a parameter change, then lets every client redesign what moved.
+
+    notify() takes a lock : only the message thread and other non realtime threads may
+    call it. Changes made on the audio thread (host automation in VST3 and AU) only bump
+    the client's own version, and the designer polls for them every
+    automationPollIntervalMs while at least one client is processing.
+ */
+struct FilterDesignThread : juce::Thread
+{
+    FilterDesignThread();
+    ~FilterDesignThread() override;
+    
+    void addClient(FilterDesignClient* client);
+    //Waits for the designer if it is currently working on this client
+    void removeClient(FilterDesignClient* client);
+    //Between prepareToPlay and releaseResources, the designer polls for the client's changes
+    void setClientProcessing(FilterDesignClient* client, bool isProcessing);
+    
+    void run() override;
+    
+private:
+    static constexpr int automationPollIntervalMs = 10;
+    
+    //clientsLock only guards the lists, designLock is held while a client designs
+    juce::CriticalSection clientsLock, designLock;
+    juce::Array<FilterDesignClient*> clients, processingClients;
+    
+    //The designer's copy of the list : adding a client never waits for a design
+    juce::Array<FilterDesignClient*> clientsToDesign;
+};
+
+//==============================================================================
+struct AnalysisClient
+{
+    virtual ~AnalysisClient() = default;
+    
+    //Called on the analysis thread, never on the message thread
+    virtual void runAnalysis() = 0;
+    
+private:
+    friend struct AnalysisThread;
+    
+    //Held by the analysis thread while it runs this client, removeClient() waits on it
+    juce::CriticalSection analysisLock;
+    //Set by AnalysisThread::requestAnalysis(), cleared by the pass that serves it
+    std::atomic<bool> analysisRequested { false };
+};
+
+/**
+    Background thread shared by every open ZooEQ editor and every spectrum capture.
+    The FFTs and the analyser paths are produced here, so the message thread only picks
+    up finished paths.
+    Every client runs once per idleIntervalMs, and once more for each requestAnalysis().
+    A client is run outside clientsLock, so adding or removing one never waits for the others.
+ */
+struct AnalysisThread : juce::Thread
+{
+    AnalysisThread();
+    ~AnalysisThread() override;
+    
+    void addClient(AnalysisClient* client);
+    //Waits for the analysis thread if it is currently working on this client
+    void removeClient(AnalysisClient* client);
+    //Runs this client on the next pass without waiting for the idle interval. Requests made
+    //before the pass gets to it are served by a single runAnalysis().
+    void requestAnalysis(AnalysisClient* client);
+    
+    void run() override;
+    
+    //No client runs while one of these is alive, so the fifos they read can be resized.
+    //Waits for the client being analysed, if any.
+    struct ScopedPause
+    {
+        explicit ScopedPause(AnalysisThread& thread) : lock(thread.pauseLock) {}
+        
+    private:
+        const juce::ScopedLock lock;
+        
+        JUCE_DECLARE_NON_COPYABLE(ScopedPause)
+    };
+    
+private:
+    //The editors request a pass once per displayed frame, this paces the clients that don't
+    static constexpr int idleIntervalMs = 100;
+    
+    //clientsLock only guards the list, pauseLock is held while any client runs
+    juce::CriticalSection clientsLock, pauseLock;
+    juce::Array<AnalysisClient*> clients;
+    
+    //The analysis thread's copy of the list
+    juce::Array<AnalysisClient*> clientsToAnalyse;
+};
+
+/**
+    Long-term average spectrum of the processor's output, for mix references and QA.
+    It reads a tap of its own on the shared analysis thread, so it keeps going while
+    no editor is open, whatever the analyser shows.
+ */
+struct SpectrumCapture : AnalysisClient
+{
+    using ChannelFifo = SingleChannelSampleFifo<juce::AudioBuffer<float>>;
+    
+    SpectrumCapture(ChannelFifo& leftFifo, ChannelFifo& rightFifo);
+    ~SpectrumCapture() override;
+    
+    // === Message thread === //
+    //Starts a new average
+    void start();
+    //The average is kept for export until the next start()
+    void stop();
+    bool isCapturing() const { return capturing; }
+    double getSecondsCaptured() const;
+    
+    //Returns false when there is nothing to export yet or the file can't be written
+    bool exportCSV(const juce::File& file) const;
+    bool exportBinary(const juce::File& file) const;
+    
+    // === Audio setup === //
+    void setSampleRate(double newSampleRate) { sampleRate = newSampleRate; }
+    
+    // === Analysis thread === //
+    void runAnalysis() override;
+    
+private:
+    std::array<ChannelFifo*, LongTermSpectrum::numChannels> channelFifos;
+    
+    std::atomic<bool> capturing { false };
+    //Set by start() : the analysis thread then starts the average over
+    std::atomic<bool> resetPending { false };
+    std::atomic<double> sampleRate { 0 };
+    
+    //Between the analysis thread and the exports
+    juce::CriticalSection spectrumLock;
+    LongTermSpectrum spectrum;
+    
+    //Both channels are handed to the spectrum in step, through these
+    static constexpr int scratchSize = 4096;
+    std::array<std::vector<float>, LongTermSpectrum::numChannels> scratch;
+    
+    template<typename WriteFunction>
+    bool exportTo(const juce::File& file, WriteFunction&& write) const;
+};
 
 //==============================================================================
 /**
 */
-class ZooEQAudioProcessor  : public juce::AudioProcessor
+class ZooEQAudioProcessor  : public juce::AudioProcessor,
+                             juce::AudioProcessorParameter::Listener,
+                             FilterDesignClient
 {
 public:
     //==============================================================================
@@ -257,6 +441,13 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+    
+    //==============================================================================
+    void parameterValueChanged (int parameterIndex, float newValue) override;
+    void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override {}
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -287,13 +478,73 @@ public:
     using BlockType = juce::AudioBuffer<float>;
     SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
     SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+    
+    SpectrumCapture& getSpectrumCapture() { return spectrumCapture; }
 private:
-    MonoChain leftChain, rightChain;
+    MultiChannelCascade filterEngine;
+    
+    std::atomic<float>* analyserEnabled = nullptr;
+    
+    // === Audio thread === //
+    void updatePeakFilter(const BiquadCoefficients& peakCoefficients, bool bypassed);
+    void updateLowCutFilters(const CutCoefficients& lowCut);
+    void updateHighCutFilter(const CutCoefficients& highCut);
+    void updateFilters(bool allowRamps);
+    
+    template<typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer);
+    
+    template<typename SampleType>
+    void processChains(const juce::dsp::AudioBlock<SampleType>& block);
+    
+    //Versions and settings of the bands currently loaded in the chains
+    int appliedLowCutVersion { -1 }, appliedPeakVersion { -1 }, appliedHighCutVersion { -1 };
+    ChainSettings appliedSettings;
+    
+    // === Automation ramps === //
+    //While a band glides towards new settings its coefficients are recomputed on a fixed grid
+    //of rampUpdateInterval samples, whatever the host buffer size. Without any movement the
+    //block is processed in one go, exactly as before.
+    static constexpr int rampUpdateInterval = 32;
+    static constexpr double rampLengthSeconds = 0.05;
+    
+    using MultiplicativeRamp = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative>;
+    MultiplicativeRamp lowCutFreqRamp, highCutFreqRamp, peakFreqRamp, peakQualityRamp;
+    juce::SmoothedValue<float> peakGainRamp;
+    int samplesUntilRampUpdate = 0;
+    
+    //A gliding cut keeps the same precision from start to end : switching kernels mid ramp would click
+    bool lowCutRampHighPrecision { false }, highCutRampHighPrecision { false };
+    
+    bool isRampingFilters() const;
+    void advanceFilterRamps(int numSamples);
+    
+    // === Designer side (never the audio thread) === //
+    void designFilters(bool forceUpdate) override;
+    
+    //Bumped by every parameter change, the designer only looks at the settings when it moved
+    juce::Atomic<int> parametersVersion { 0 };
+    juce::Atomic<double> designSampleRate { 0.0 };
+    
+    juce::CriticalSection designLock;
+    int lastParametersVersion { -1 };
+    double lastSampleRate { 0.0 };
+    ChainSettings lastChainSettings;
+    FilterCoefficientSet designedCoefficients;
+    
+    TripleBuffer<FilterCoefficientSet> coefficientSets;
+    juce::SharedResourcePointer<FilterDesignThread> designThread;
     
-    void updatePeakFilter(const ChainSettings& chainSettings);
-    void updateLowCutFilters(const ChainSettings& chainSettings);
-    void updateHighCutFilter(const ChainSettings& chainSettings);
-    void updateFilters();
+    // === Long-term spectrum === //
+    //A tap of its own : the analyser's rings only have room for one reader.
+    //Without an editor the analysis thread only comes by every 100 ms, 1 << 17 samples still
+    //leave more than half a second of room at 192kHz. The size doesn't follow the sample rate,
+    //so the rings are only allocated by the first prepareToPlay.
+    static constexpr int captureFifoCapacity = 1 << 17;
+    SingleChannelSampleFifo<BlockType> leftCaptureFifo { Channel::Left };
+    SingleChannelSampleFifo<BlockType> rightCaptureFifo { Channel::Right };
+    SpectrumCapture spectrumCapture { leftCaptureFifo, rightCaptureFifo };
+    juce::SharedResourcePointer<AnalysisThread> analysisThread;
     
     juce::dsp::Oscillator<float> osc;
     //==============================================================================
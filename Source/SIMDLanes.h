@@ -0,0 +1,220 @@
+/*
+  ==============================================================================
+
+    SIMDLanes.h
+    Thin wrappers over the native float vectors, for the kernels that need lane
+    shuffles juce::dsp::SIMDRegister doesn't offer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <cstring>
+
+#if JUCE_USE_SIMD && (defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP == 2))
+ #define ZOOEQ_SIMD_SSE 1
+ #include <immintrin.h>
+ #if defined (__AVX2__)
+  #define ZOOEQ_SIMD_AVX2 1
+ #endif
+#elif JUCE_USE_SIMD && (defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64))
+ #define ZOOEQ_SIMD_NEON 1
+ #include <arm_neon.h>
+#endif
+
+#if ZOOEQ_SIMD_SSE || ZOOEQ_SIMD_NEON
+ #define ZOOEQ_SIMD 1
+#else
+ #define ZOOEQ_SIMD 0
+#endif
+
+//log2(x) for x > 0 from the float's exponent and a polynomial in its mantissa : log2(1 + t) for t in [0, 1[
+//to within 1e-4 (6e-4 dB), without any call to the maths library. Zero gives -127.
+struct FastLog2
+{
+    static constexpr float c1 = 1.43901660f, c2 = -0.679961815f, c3 = 0.325636038f, c4 = -0.0847943897f;
+
+    static float compute(float x)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+
+        auto exponent = (float)((int)(bits >> 23) - 127);
+
+        bits = (bits & 0x007fffffu) | 0x3f800000u;
+        float mantissa;
+        std::memcpy(&mantissa, &bits, sizeof(bits));
+
+        auto t = mantissa - 1.f;
+        return exponent + t * (c1 + t * (c2 + t * (c3 + t * c4)));
+    }
+};
+
+#if ZOOEQ_SIMD_SSE
+struct SIMDLanes4
+{
+    using Reg = __m128;
+    using Mask = __m128;
+    static constexpr int numLanes = 4;
+
+    static Reg load(const float* p)                 { return _mm_load_ps(p); }
+    static Reg loadUnaligned(const float* p)        { return _mm_loadu_ps(p); }
+    static void store(float* p, Reg r)              { _mm_store_ps(p, r); }
+    static void storeUnaligned(float* p, Reg r)     { _mm_storeu_ps(p, r); }
+    static Reg expand(float v)                      { return _mm_set1_ps(v); }
+    static Reg add(Reg a, Reg b)                    { return _mm_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b)                    { return _mm_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b)                    { return _mm_mul_ps(a, b); }
+    static Reg max(Reg a, Reg b)                    { return _mm_max_ps(a, b); }
+    static Reg min(Reg a, Reg b)                    { return _mm_min_ps(a, b); }
+    static Reg select(Mask m, Reg a, Reg b)         { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+    //FastLog2 on every lane
+    static Reg log2(Reg x)
+    {
+        auto bits = _mm_castps_si128(x);
+        auto exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+        auto mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+                                                      _mm_set1_epi32(0x3f800000)));
+        auto t = _mm_sub_ps(mantissa, _mm_set1_ps(1.f));
+
+        auto p = _mm_add_ps(_mm_set1_ps(FastLog2::c3), _mm_mul_ps(t, _mm_set1_ps(FastLog2::c4)));
+        p = _mm_add_ps(_mm_set1_ps(FastLog2::c2), _mm_mul_ps(t, p));
+        p = _mm_add_ps(_mm_set1_ps(FastLog2::c1), _mm_mul_ps(t, p));
+        return _mm_add_ps(exponent, _mm_mul_ps(t, p));
+    }
+
+    //[x, r0, r1, r2] : every lane moves one up and x enters lane 0
+    static Reg shiftIn(Reg r, float x)
+    {
+        return _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(r), 4)), _mm_set_ss(x));
+    }
+
+    static float lastLane(Reg r)                    { return getLane<3>(r); }
+
+    template<int Lane>
+    static float getLane(Reg r)                     { return _mm_cvtss_f32(_mm_shuffle_ps(r, r, _MM_SHUFFLE(Lane, Lane, Lane, Lane))); }
+
+    //Lanes whose index lies in ]lowExclusive, highInclusive]
+    static Mask lanesBetween(float lowExclusive, float highInclusive)
+    {
+        auto index = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+        return _mm_and_ps(_mm_cmpgt_ps(index, _mm_set1_ps(lowExclusive)),
+                          _mm_cmple_ps(index, _mm_set1_ps(highInclusive)));
+    }
+};
+#elif ZOOEQ_SIMD_NEON
+struct SIMDLanes4
+{
+    using Reg = float32x4_t;
+    using Mask = uint32x4_t;
+    static constexpr int numLanes = 4;
+
+    static Reg load(const float* p)                 { return vld1q_f32(p); }
+    static Reg loadUnaligned(const float* p)        { return vld1q_f32(p); }
+    static void store(float* p, Reg r)              { vst1q_f32(p, r); }
+    static void storeUnaligned(float* p, Reg r)     { vst1q_f32(p, r); }
+    static Reg expand(float v)                      { return vdupq_n_f32(v); }
+    static Reg add(Reg a, Reg b)                    { return vaddq_f32(a, b); }
+    static Reg sub(Reg a, Reg b)                    { return vsubq_f32(a, b); }
+    static Reg mul(Reg a, Reg b)                    { return vmulq_f32(a, b); }
+    static Reg max(Reg a, Reg b)                    { return vmaxq_f32(a, b); }
+    static Reg min(Reg a, Reg b)                    { return vminq_f32(a, b); }
+    static Reg select(Mask m, Reg a, Reg b)         { return vbslq_f32(m, a, b); }
+
+    //FastLog2 on every lane
+    static Reg log2(Reg x)
+    {
+        auto bits = vreinterpretq_u32_f32(x);
+        auto exponent = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+        auto mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffffu)),
+                                                        vdupq_n_u32(0x3f800000u)));
+        auto t = vsubq_f32(mantissa, vdupq_n_f32(1.f));
+
+        auto p = vaddq_f32(vdupq_n_f32(FastLog2::c3), vmulq_f32(t, vdupq_n_f32(FastLog2::c4)));
+        p = vaddq_f32(vdupq_n_f32(FastLog2::c2), vmulq_f32(t, p));
+        p = vaddq_f32(vdupq_n_f32(FastLog2::c1), vmulq_f32(t, p));
+        return vaddq_f32(exponent, vmulq_f32(t, p));
+    }
+
+    //[x, r0, r1, r2] : every lane moves one up and x enters lane 0
+    static Reg shiftIn(Reg r, float x)              { return vextq_f32(vdupq_n_f32(x), r, 3); }
+
+    static float lastLane(Reg r)                    { return vgetq_lane_f32(r, 3); }
+
+    template<int Lane>
+    static float getLane(Reg r)                     { return vgetq_lane_f32(r, Lane); }
+
+    //Lanes whose index lies in ]lowExclusive, highInclusive]
+    static Mask lanesBetween(float lowExclusive, float highInclusive)
+    {
+        const float indices[] { 0.f, 1.f, 2.f, 3.f };
+        auto index = vld1q_f32(indices);
+        return vandq_u32(vcgtq_f32(index, vdupq_n_f32(lowExclusive)),
+                         vcleq_f32(index, vdupq_n_f32(highInclusive)));
+    }
+};
+#endif
+
+#if ZOOEQ_SIMD_AVX2
+struct SIMDLanes8
+{
+    using Reg = __m256;
+    using Mask = __m256;
+    static constexpr int numLanes = 8;
+
+    static Reg load(const float* p)                 { return _mm256_load_ps(p); }
+    static Reg loadUnaligned(const float* p)        { return _mm256_loadu_ps(p); }
+    static void store(float* p, Reg r)              { _mm256_store_ps(p, r); }
+    static void storeUnaligned(float* p, Reg r)     { _mm256_storeu_ps(p, r); }
+    static Reg expand(float v)                      { return _mm256_set1_ps(v); }
+    static Reg add(Reg a, Reg b)                    { return _mm256_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b)                    { return _mm256_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b)                    { return _mm256_mul_ps(a, b); }
+    static Reg max(Reg a, Reg b)                    { return _mm256_max_ps(a, b); }
+    static Reg min(Reg a, Reg b)                    { return _mm256_min_ps(a, b); }
+    static Reg select(Mask m, Reg a, Reg b)         { return _mm256_blendv_ps(b, a, m); }
+
+    //FastLog2 on every lane
+    static Reg log2(Reg x)
+    {
+        auto bits = _mm256_castps_si256(x);
+        auto exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        auto mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+                                                            _mm256_set1_epi32(0x3f800000)));
+        auto t = _mm256_sub_ps(mantissa, _mm256_set1_ps(1.f));
+
+        auto p = _mm256_add_ps(_mm256_set1_ps(FastLog2::c3), _mm256_mul_ps(t, _mm256_set1_ps(FastLog2::c4)));
+        p = _mm256_add_ps(_mm256_set1_ps(FastLog2::c2), _mm256_mul_ps(t, p));
+        p = _mm256_add_ps(_mm256_set1_ps(FastLog2::c1), _mm256_mul_ps(t, p));
+        return _mm256_add_ps(exponent, _mm256_mul_ps(t, p));
+    }
+
+    //[x, r0, ..., r6] : every lane moves one up and x enters lane 0
+    static Reg shiftIn(Reg r, float x)
+    {
+        auto shifted = _mm256_permutevar8x32_ps(r, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6));
+        return _mm256_blend_ps(shifted, _mm256_set1_ps(x), 1);
+    }
+
+    static float lastLane(Reg r)                    { return getLane<7>(r); }
+
+    template<int Lane>
+    static float getLane(Reg r)
+    {
+        auto half = _mm256_extractf128_ps(r, Lane / 4);
+        return _mm_cvtss_f32(_mm_shuffle_ps(half, half, _MM_SHUFFLE(Lane % 4, Lane % 4, Lane % 4, Lane % 4)));
+    }
+
+    //Lanes whose index lies in ]lowExclusive, highInclusive]
+    static Mask lanesBetween(float lowExclusive, float highInclusive)
+    {
+        auto index = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+        return _mm256_and_ps(_mm256_cmp_ps(index, _mm256_set1_ps(lowExclusive), _CMP_GT_OQ),
+                             _mm256_cmp_ps(index, _mm256_set1_ps(highInclusive), _CMP_LE_OQ));
+    }
+};
+#endif
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    SampleRing.h
+    Lock-free single producer / single consumer ring of samples.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+/**
+    The producer (audio thread) copies whole blocks in with one or two memcpys, the
+    consumer reads the ready samples in place as at most two contiguous spans and then
+    releases them with finishedRead(). Nothing is allocated outside of prepare().
+
+    When the consumer falls behind the producer only writes what fits : the samples
+    already in the ring are never overwritten while they may be being read.
+ */
+struct SampleRing
+{
+    //Up to two contiguous runs of samples, in order, owned by the ring
+    struct ReadSpan
+    {
+        const float* data1 = nullptr;
+        int size1 = 0;
+        const float* data2 = nullptr;
+        int size2 = 0;
+
+        int getNumSamples() const { return size1 + size2; }
+
+        //Copies numSamples samples of the span, from startSample on, to dest
+        void copy(float* dest, int startSample, int numSamples) const
+        {
+            jassert(startSample >= 0 && startSample + numSamples <= getNumSamples());
+
+            auto skip1 = juce::jmin(startSample, size1);
+            auto num1 = juce::jmin(size1 - skip1, numSamples);
+
+            if ( num1 > 0 )
+                juce::FloatVectorOperations::copy(dest, data1 + skip1, num1);
+
+            auto skip2 = startSample - skip1;
+            auto num2 = numSamples - num1;
+
+            if ( num2 > 0 )
+                juce::FloatVectorOperations::copy(dest + num1, data2 + skip2, num2);
+        }
+
+        //Copies the last numSamples samples of the span to dest
+        void copyLast(float* dest, int numSamples) const
+        {
+            jassert(numSamples <= getNumSamples());
+            copy(dest, getNumSamples() - numSamples, numSamples);
+        }
+    };
+
+    //Not thread safe : call it while neither side is running
+    void prepare(int capacity)
+    {
+        //The AbstractFifo keeps one slot free to tell full from empty
+        auto size = capacity + 1;
+
+        if ( (int)buffer.size() < size )
+            buffer.assign((size_t)size, 0.f);
+
+        fifo.setTotalSize(size);
+        fifo.reset();
+    }
+
+    // === Producer === //
+    //Returns the number of samples written, less than numSamples when the consumer is behind
+    template<typename SampleType>
+    int write(const SampleType* data, int numSamples)
+    {
+        //More than the ring can ever hold : only the most recent samples are of any use
+        if ( auto excess = numSamples - (fifo.getTotalSize() - 1); excess > 0 )
+        {
+            data += excess;
+            numSamples -= excess;
+        }
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+        copySamples(buffer.data() + start1, data, size1);
+        copySamples(buffer.data() + start2, data + size1, size2);
+
+        fifo.finishedWrite(size1 + size2);
+        return size1 + size2;
+    }
+
+    // === Consumer === //
+    int getNumReady() const { return fifo.getNumReady(); }
+
+    //The returned samples stay valid until finishedRead()
+    ReadSpan getReadSpan(int maxSamples) const
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(maxSamples, start1, size1, start2, size2);
+
+        return { buffer.data() + start1, size1, buffer.data() + start2, size2 };
+    }
+
+    void finishedRead(int numSamples) { fifo.finishedRead(numSamples); }
+
+private:
+    std::vector<float> buffer;
+    juce::AbstractFifo fifo { 1 };
+
+    static void copySamples(float* dest, const float* source, int numSamples)
+    {
+        if ( numSamples > 0 )
+            juce::FloatVectorOperations::copy(dest, source, numSamples);
+    }
+
+    static void copySamples(float* dest, const double* source, int numSamples)
+    {
+        for ( int i = 0; i < numSamples; ++i )
+            dest[i] = (float)source[i];
+    }
+};
@@ -0,0 +1,450 @@
+/*
+  ==============================================================================
+
+    SpectrumMath.h
+    Vectorised helpers for the analyser and the response curve display.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SIMDLanes.h"
+#include "BiquadCascade.h"
+
+//In place 20 * log10(gain), floored at minusInfinityDb. The gains must not be negative.
+inline void gainsToDecibels(float* data, int numValues, float minusInfinityDb)
+{
+    //20 * log10(x) = 20 * log10(2) * log2(x)
+    constexpr float decibelsPerOctave = 6.02059991f;
+
+    int i = 0;
+
+   #if ZOOEQ_SIMD
+   #if ZOOEQ_SIMD_AVX2
+    using Lanes = SIMDLanes8;
+   #else
+    using Lanes = SIMDLanes4;
+   #endif
+
+    const auto scale = Lanes::expand(decibelsPerOctave);
+    const auto floor = Lanes::expand(minusInfinityDb);
+
+    for ( ; i + Lanes::numLanes <= numValues; i += Lanes::numLanes )
+    {
+        auto db = Lanes::mul(Lanes::log2(Lanes::loadUnaligned(data + i)), scale);
+        Lanes::storeUnaligned(data + i, Lanes::max(db, floor));
+    }
+   #endif
+
+    for ( ; i < numValues; ++i )
+        data[i] = juce::jmax(minusInfinityDb, decibelsPerOctave * FastLog2::compute(data[i]));
+}
+
+/**
+    Where the bins of one spectrum come from. A plain FFT is a single band. The
+    multirate analyser's octave bands follow each other, each with its own bin
+    width, and each one only covers its own part of the frequency axis.
+ */
+struct SpectrumBand
+{
+    int firstBin = 0;               //In the spectrum
+    int numBins = 0;
+    double binWidth = 0;            //Hz
+    double lowestFrequency = 0;     //Part of the axis taken from this band
+    double highestFrequency = 0;
+
+    bool operator==(const SpectrumBand& other) const
+    {
+        return firstBin == other.firstBin && numBins == other.numBins && binWidth == other.binWidth
+            && lowestFrequency == other.lowestFrequency && highestFrequency == other.highestFrequency;
+    }
+};
+
+struct SpectrumLayout
+{
+    static constexpr int maxBands = 16;
+
+    //One band covering DC to Nyquist
+    static SpectrumLayout linear(int fftSize, double sampleRate)
+    {
+        SpectrumLayout layout;
+        layout.addBand(fftSize / 2, sampleRate / (double)fftSize, 0.0, sampleRate / 2.0);
+        return layout;
+    }
+
+    void addBand(int numBins, double binWidth, double lowestFrequency, double highestFrequency)
+    {
+        jassert(numBands < maxBands);
+        bands[(size_t)numBands++] = { numBinsPerSpectrum, numBins, binWidth, lowestFrequency, highestFrequency };
+        numBinsPerSpectrum += numBins;
+    }
+
+    int getNumBands() const { return numBands; }
+    const SpectrumBand& getBand(int index) const { return bands[(size_t)index]; }
+    int getNumBins() const { return numBinsPerSpectrum; }
+
+    bool operator==(const SpectrumLayout& other) const
+    {
+        return numBands == other.numBands && std::equal(bands.begin(), bands.begin() + numBands, other.bands.begin());
+    }
+
+    bool operator!=(const SpectrumLayout& other) const { return ! (*this == other); }
+
+private:
+    std::array<SpectrumBand, maxBands> bands {};
+    int numBands = 0;
+    int numBinsPerSpectrum = 0;
+};
+
+/**
+    Bin to pixel column table for the analyser's log frequency axis (20 Hz to 20 kHz).
+    A column covering several bins keeps the loudest of them, a column narrower than a
+    bin interpolates between the two bins around its centre. Each column reads from the
+    band its centre falls in. Only rebuilt when the width or the layout change, a frame
+    then costs one pass over the columns.
+ */
+struct SpectrumColumnMap
+{
+    bool matches(int numColumns, const SpectrumLayout& layout) const
+    {
+        return numColumns == getNumColumns() && layout == mappedLayout;
+    }
+
+    //Allocates
+    void prepare(int numColumns, const SpectrumLayout& layout)
+    {
+        numColumns = juce::jmax(0, numColumns);
+        mappedLayout = layout;
+        columns.resize((size_t)numColumns);
+
+        auto frequencyAt = [](double normalisedX)
+        {
+            return juce::mapToLog10(normalisedX, 20.0, 20000.0);
+        };
+
+        for ( int c = 0; c < numColumns; ++c )
+        {
+            auto& column = columns[(size_t)c];
+            auto centreFrequency = frequencyAt((c + 0.5) / numColumns);
+            auto bandIndex = findBand(centreFrequency);
+
+            if ( bandIndex < 0 )
+            {
+                column = {};
+                continue;
+            }
+
+            const auto& band = layout.getBand(bandIndex);
+
+            if ( centreFrequency >= band.highestFrequency )
+            {
+                //The axis goes past Nyquist : the last bin is held
+                column = { band.firstBin + band.numBins - 1, 1, 0.f };
+                continue;
+            }
+
+            //Only the bins inside the band's own range
+            auto lowestBin = (int)std::ceil(band.lowestFrequency / band.binWidth);
+            auto highestBin = juce::jmin((int)std::floor(band.highestFrequency / band.binWidth), band.numBins - 1);
+
+            auto firstBin = juce::jmax((int)std::ceil(frequencyAt((double)c / numColumns) / band.binWidth), lowestBin);
+            auto endBin = juce::jmin((int)std::ceil(frequencyAt((double)(c + 1) / numColumns) / band.binWidth), highestBin + 1);
+
+            if ( endBin > firstBin )
+            {
+                column = { band.firstBin + firstBin, endBin - firstBin, 0.f };
+            }
+            else
+            {
+                auto centre = juce::jlimit(0.0, (double)(band.numBins - 2), centreFrequency / band.binWidth);
+                auto bin = (int)centre;
+                column = { band.firstBin + bin, 0, (float)(centre - bin) };
+            }
+        }
+    }
+
+    //binsInDecibels holds one spectrum of the layout, dest getNumColumns()
+    void rasterise(const float* binsInDecibels, float* dest) const
+    {
+        for ( const auto& column : columns )
+        {
+            const auto* bins = binsInDecibels + column.firstBin;
+
+            *dest++ = column.numBins > 0 ? juce::FloatVectorOperations::findMaximum(bins, column.numBins)
+                                         : bins[0] + column.fraction * (bins[1] - bins[0]);
+        }
+    }
+
+    int getNumColumns() const { return (int)columns.size(); }
+
+private:
+    struct Column
+    {
+        int firstBin = 0;
+        int numBins = 0;        //0 : interpolated
+        float fraction = 0;
+    };
+
+    std::vector<Column> columns;
+    SpectrumLayout mappedLayout;
+
+    //The band covering frequency, the one reaching the highest past its top
+    int findBand(double frequency) const
+    {
+        int highest = -1;
+
+        for ( int i = 0; i < mappedLayout.getNumBands(); ++i )
+        {
+            const auto& band = mappedLayout.getBand(i);
+
+            if ( frequency >= band.lowestFrequency && frequency < band.highestFrequency )
+                return i;
+
+            if ( highest < 0 || band.highestFrequency > mappedLayout.getBand(highest).highestFrequency )
+                highest = i;
+        }
+
+        return highest;
+    }
+};
+
+/**
+    Frame to frame smoothing of the analyser's columns, in dB. A value that rises moves
+    towards the new frame by the attack coefficient, one that falls by the release
+    coefficient : equal coefficients are a plain exponential average, a fast attack
+    with a slow release gives meter ballistics, and 1 for both passes the frames through.
+    The peak trace jumps up to the smoothed values and otherwise falls at a fixed rate.
+    The state is only allocated by prepare(), process() is flat vectorised passes.
+ */
+struct SpectrumBallistics
+{
+    //Allocates, and starts over from the frame that comes next
+    void prepare(int numValues)
+    {
+        smoothed.assign((size_t)juce::jmax(0, numValues), 0.f);
+        peaks.assign(smoothed.size(), 0.f);
+        primed = false;
+    }
+
+    int getNumValues() const { return (int)smoothed.size(); }
+
+    void reset() { primed = false; }
+
+    /**
+        values holds getNumValues() decibels, they are replaced by the smoothed ones and
+        the peaks are written to peaksOut. peakFall is in dB for this frame.
+     */
+    void process(float* values, float* peaksOut, float attack, float release, float peakFall)
+    {
+        const auto numValues = getNumValues();
+        auto* state = smoothed.data();
+        auto* peak = peaks.data();
+
+        //The first frame after prepare() is taken as it is
+        if ( ! primed )
+        {
+            std::copy(values, values + numValues, state);
+            std::copy(values, values + numValues, peak);
+            primed = true;
+        }
+
+        int i = 0;
+
+       #if ZOOEQ_SIMD
+       #if ZOOEQ_SIMD_AVX2
+        using Lanes = SIMDLanes8;
+       #else
+        using Lanes = SIMDLanes4;
+       #endif
+
+        const auto zero = Lanes::expand(0.f);
+        const auto up = Lanes::expand(attack);
+        const auto down = Lanes::expand(release);
+        const auto fall = Lanes::expand(peakFall);
+
+        for ( ; i + Lanes::numLanes <= numValues; i += Lanes::numLanes )
+        {
+            auto y = Lanes::loadUnaligned(state + i);
+            auto d = Lanes::sub(Lanes::loadUnaligned(values + i), y);
+
+            y = Lanes::add(y, Lanes::add(Lanes::mul(Lanes::max(d, zero), up), Lanes::mul(Lanes::min(d, zero), down)));
+            auto p = Lanes::max(y, Lanes::sub(Lanes::loadUnaligned(peak + i), fall));
+
+            Lanes::storeUnaligned(state + i, y);
+            Lanes::storeUnaligned(values + i, y);
+            Lanes::storeUnaligned(peak + i, p);
+            Lanes::storeUnaligned(peaksOut + i, p);
+        }
+       #endif
+
+        for ( ; i < numValues; ++i )
+        {
+            auto d = values[i] - state[i];
+            auto y = state[i] + (d > 0 ? attack : release) * d;
+
+            state[i] = values[i] = y;
+            peak[i] = peaksOut[i] = juce::jmax(y, peak[i] - peakFall);
+        }
+    }
+
+private:
+    std::vector<float> smoothed, peaks;
+    bool primed = false;
+};
+
+/**
+    Magnitude response of a chain of biquads on the same log axis, one value per pixel
+    column. The e^-jw and e^-2jw terms of every column are tabulated once per width and
+    sample rate. A new response is then a handful of multiply-adds per section and
+    column, in flat loops the compiler vectorises across columns. It stays in double :
+    close to DC a steep high-pass's denominator cancels down to about 1e-6.
+ */
+struct BiquadResponseTable
+{
+    bool matches(int numColumns, double sampleRate) const
+    {
+        return numColumns == getNumColumns() && sampleRate == mappedSampleRate;
+    }
+
+    //Allocates
+    void prepare(int numColumns, double sampleRate)
+    {
+        numColumns = juce::jmax(0, numColumns);
+        mappedSampleRate = sampleRate;
+
+        for ( auto* v : { &cos1, &sin1, &cos2, &sin2, &magnitudeSquared } )
+            v->resize((size_t)numColumns);
+
+        for ( int c = 0; c < numColumns; ++c )
+        {
+            auto freq = juce::mapToLog10((double)c / (double)numColumns, 20.0, 20000.0);
+            auto omega = juce::MathConstants<double>::twoPi * freq / sampleRate;
+
+            cos1[(size_t)c] = std::cos(omega);
+            sin1[(size_t)c] = std::sin(omega);
+            cos2[(size_t)c] = std::cos(2.0 * omega);
+            sin2[(size_t)c] = std::sin(2.0 * omega);
+        }
+    }
+
+    //dest holds getNumColumns() values, in dB
+    void computeDecibels(const BiquadCoefficients* sections, int numSections, double* dest)
+    {
+        const auto numColumns = getNumColumns();
+        auto* mag = magnitudeSquared.data();
+        const auto* c1 = cos1.data();
+        const auto* s1 = sin1.data();
+        const auto* c2 = cos2.data();
+        const auto* s2 = sin2.data();
+
+        std::fill(magnitudeSquared.begin(), magnitudeSquared.end(), 1.0);
+
+        //|H|^2 = |b0 + b1 e^-jw + b2 e^-2jw|^2 / |1 + a1 e^-jw + a2 e^-2jw|^2
+        for ( int s = 0; s < numSections; ++s )
+        {
+            const auto& k = sections[s];
+
+            for ( int c = 0; c < numColumns; ++c )
+            {
+                auto numRe = k.b0 + k.b1 * c1[c] + k.b2 * c2[c];
+                auto numIm = k.b1 * s1[c] + k.b2 * s2[c];
+                auto denRe = 1.0 + k.a1 * c1[c] + k.a2 * c2[c];
+                auto denIm = k.a1 * s1[c] + k.a2 * s2[c];
+
+                mag[c] *= (numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm);
+            }
+        }
+
+        //10 * log10 of the squared magnitude, with the same floor as juce::Decibels
+        for ( int c = 0; c < numColumns; ++c )
+            dest[c] = mag[c] > 0.0 ? juce::jmax(-100.0, 10.0 * std::log10(mag[c])) : -100.0;
+    }
+
+    int getNumColumns() const { return (int)cos1.size(); }
+
+private:
+    std::vector<double> cos1, sin1, cos2, sin2, magnitudeSquared;
+    double mappedSampleRate = 0;
+};
+
+//What the two analyser curves show
+enum StereoView
+{
+    leftRight,
+    midSide
+};
+
+/**
+    Magnitude spectra of a stereo frame from a single complex FFT. Left and right go in
+    as its real and imaginary parts and are told apart again by conjugate symmetry, so a
+    stereo frame costs one FFT. Mid and side come from the same transform.
+ */
+struct StereoSpectrumTransform
+{
+    //Allocates
+    void prepare(int order)
+    {
+        fftSize = 1 << order;
+        fft = std::make_unique<juce::dsp::FFT>(order);
+
+        //The FFT is linear : scaling its input by 1 / numBins normalises the magnitudes the same way
+        windowTable.resize((size_t)fftSize);
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(windowTable.data(),
+                                                                  (size_t)fftSize,
+                                                                  juce::dsp::WindowingFunction<float>::blackmanHarris,
+                                                                  true);
+        juce::FloatVectorOperations::multiply(windowTable.data(), 2.f / (float)fftSize, fftSize);
+
+        timeData.assign((size_t)fftSize, {});
+        frequencyData.assign((size_t)fftSize, {});
+    }
+
+    /**
+        left and right hold getFFTSize() samples. first and second receive getFFTSize() / 2
+        linear magnitudes each : left and right, or mid and side.
+     */
+    void perform(const float* left, const float* right, StereoView view, float* first, float* second)
+    {
+        const auto numBins = fftSize / 2;
+        const auto* window = windowTable.data();
+
+        //Copy, window and normalisation in a single pass : x = left + j right
+        for ( int i = 0; i < fftSize; ++i )
+            timeData[(size_t)i] = { left[i] * window[i], right[i] * window[i] };
+
+        fft->perform(timeData.data(), frequencyData.data(), false);
+
+        //X[k] = L[k] + j R[k], and conj(X[N - k]) = L[k] - j R[k] since both inputs are real
+        const auto* X = frequencyData.data();
+
+        for ( int k = 0; k < numBins; ++k )
+        {
+            auto a = X[k];
+            auto b = std::conj(X[(fftSize - k) & (fftSize - 1)]);
+
+            auto l = (a + b) * 0.5f;
+            auto r = (a - b) * juce::dsp::Complex<float>(0.f, -0.5f);
+
+            if ( view == StereoView::midSide )
+            {
+                auto mid = (l + r) * 0.5f;
+                auto side = (l - r) * 0.5f;
+                l = mid;
+                r = side;
+            }
+
+            first[k] = std::sqrt(std::norm(l));
+            second[k] = std::sqrt(std::norm(r));
+        }
+    }
+
+    int getFFTSize() const { return fftSize; }
+
+private:
+    int fftSize = 0;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> windowTable;
+    std::vector<juce::dsp::Complex<float>> timeData, frequencyData;
+};
@@ -0,0 +1,168 @@
+/*
+  ==============================================================================
+
+    AllocationCounter.cpp
+
+  ==============================================================================
+*/
+
+#include "AllocationCounter.h"
+#include <new>
+#include <cstdlib>
+#include <cerrno>
+
+#if JUCE_LINUX && defined (__GLIBC__)
+ #define ZOOEQ_COUNT_MALLOC 1
+#else
+ #define ZOOEQ_COUNT_MALLOC 0
+#endif
+
+namespace
+{
+//Plain thread locals, constant initialised : safe to touch from inside malloc
+thread_local bool isCounting = false;
+thread_local juce::int64 numAllocations = 0;
+
+inline void countAllocation() noexcept
+{
+    if ( isCounting )
+        ++numAllocations;
+}
+}
+
+//==============================================================================
+AllocationCounter::Scope::Scope()
+{
+    wasCounting = isCounting;
+    isCounting = true;
+    startCount = numAllocations;
+}
+
+AllocationCounter::Scope::~Scope()
+{
+    isCounting = wasCounting;
+}
+
+juce::int64 AllocationCounter::Scope::getNumAllocations() const
+{
+    return numAllocations - startCount;
+}
+
+void AllocationCounter::Scope::reset()
+{
+    startCount = numAllocations;
+}
+
+bool AllocationCounter::countsMalloc()
+{
+    return ZOOEQ_COUNT_MALLOC != 0;
+}
+
+//==============================================================================
+#if ZOOEQ_COUNT_MALLOC
+extern "C"
+{
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+
+void* malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size)
+{
+    countAllocation();
+    *result = __libc_memalign(alignment, size);
+    return *result != nullptr ? 0 : ENOMEM;
+}
+}
+#endif
+
+//==============================================================================
+namespace
+{
+void* allocate(std::size_t size)
+{
+   #if ! ZOOEQ_COUNT_MALLOC
+    countAllocation();
+   #endif
+
+    if ( auto* p = std::malloc(size > 0 ? size : 1) )
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+   #if ! ZOOEQ_COUNT_MALLOC
+    countAllocation();
+   #endif
+
+    auto align = juce::jmax(sizeof(void*), static_cast<std::size_t>(alignment));
+    void* p = nullptr;
+
+   #if JUCE_WINDOWS
+    p = _aligned_malloc(size > 0 ? size : 1, align);
+   #else
+    if ( posix_memalign(&p, align, size > 0 ? size : 1) != 0 )
+        p = nullptr;
+   #endif
+
+    if ( p == nullptr )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void freeAligned(void* p) noexcept
+{
+   #if JUCE_WINDOWS
+    _aligned_free(p);
+   #else
+    std::free(p);
+   #endif
+}
+}
+
+void* operator new(std::size_t size)                                               { return allocate(size); }
+void* operator new[](std::size_t size)                                             { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment)                   { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment)                 { return allocateAligned(size, alignment); }
+
+void operator delete(void* p) noexcept                                             { std::free(p); }
+void operator delete[](void* p) noexcept                                           { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept                                { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept                              { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept                           { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept                         { freeAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept              { freeAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept            { freeAligned(p); }
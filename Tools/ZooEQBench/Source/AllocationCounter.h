@@ -0,0 +1,41 @@
+/*
+  ==============================================================================
+
+    AllocationCounter.h
+    Counts the heap allocations made by one thread, to check real-time safety.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    While a Scope is alive, every allocation made by the thread that created it is counted.
+
+    The global operator new / new[] (all variants) are replaced in AllocationCounter.cpp.
+    With glibc, malloc / calloc / realloc / memalign are interposed too, so that JUCE's
+    HeapBlock based containers are caught as well as the standard ones.
+ */
+struct AllocationCounter
+{
+    struct Scope
+    {
+        Scope();
+        ~Scope();
+
+        //Allocations since the Scope was created or since the last reset()
+        juce::int64 getNumAllocations() const;
+        void reset();
+
+    private:
+        juce::int64 startCount = 0;
+        bool wasCounting = false;
+
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+
+    //True when malloc itself is counted, not only operator new
+    static bool countsMalloc();
+};
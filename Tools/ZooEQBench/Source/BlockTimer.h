@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    BlockTimer.h
+    Per-block timing for the benchmarks : wall clock and, where available, cycles.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+ #define ZOOEQ_BENCH_HAS_CYCLES 1
+#else
+ #define ZOOEQ_BENCH_HAS_CYCLES 0
+#endif
+
+struct BlockTimer
+{
+    using Clock = std::chrono::steady_clock;
+
+    void start()
+    {
+        startTime = Clock::now();
+       #if ZOOEQ_BENCH_HAS_CYCLES
+        startCycles = __rdtsc();
+       #endif
+    }
+
+    void stop()
+    {
+       #if ZOOEQ_BENCH_HAS_CYCLES
+        lastCycles = (double)(__rdtsc() - startCycles);
+       #endif
+        lastNanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+    }
+
+    double getLastNanoseconds() const { return lastNanoseconds; }
+
+    //Time stamp counter ticks : core cycles at the nominal frequency on every recent x86
+    double getLastCycles() const { return lastCycles; }
+
+    static constexpr bool hasCycles() { return ZOOEQ_BENCH_HAS_CYCLES != 0; }
+
+private:
+    Clock::time_point startTime;
+    double lastNanoseconds = 0, lastCycles = 0;
+   #if ZOOEQ_BENCH_HAS_CYCLES
+    unsigned long long startCycles = 0;
+   #endif
+};
+
+/**
+    Collects one value per block (preallocated, so recording never allocates) and
+    summarises them once the run is over.
+ */
+struct BlockStatistics
+{
+    void prepare(int maxNumBlocks)
+    {
+        nanoseconds.clearQuick();
+        cycles.clearQuick();
+        nanoseconds.ensureStorageAllocated(maxNumBlocks);
+        cycles.ensureStorageAllocated(maxNumBlocks);
+        totalSamples = 0;
+    }
+
+    void record(const BlockTimer& timer, int numSamples)
+    {
+        jassert(nanoseconds.size() < nanoseconds.getNumAllocated());
+        nanoseconds.add(timer.getLastNanoseconds());
+        cycles.add(timer.getLastCycles());
+        totalSamples += numSamples;
+    }
+
+    int getNumBlocks() const { return nanoseconds.size(); }
+    juce::int64 getTotalSamples() const { return totalSamples; }
+
+    double getNanosecondsPerSample() const { return totalSamples > 0 ? sum(nanoseconds) / (double)totalSamples : 0.0; }
+    double getCyclesPerSample() const { return totalSamples > 0 ? sum(cycles) / (double)totalSamples : 0.0; }
+
+    //proportion in [0, 1], in microseconds
+    double getPercentileMicroseconds(double proportion) const
+    {
+        if ( nanoseconds.isEmpty() )
+            return 0.0;
+
+        auto sorted = nanoseconds;
+        std::sort(sorted.begin(), sorted.end());
+
+        auto index = juce::jlimit(0, sorted.size() - 1, (int)std::ceil(proportion * sorted.size()) - 1);
+        return sorted[index] / 1000.0;
+    }
+
+    double getMaxMicroseconds() const
+    {
+        return nanoseconds.isEmpty() ? 0.0 : *std::max_element(nanoseconds.begin(), nanoseconds.end()) / 1000.0;
+    }
+
+private:
+    juce::Array<double> nanoseconds, cycles;
+    juce::int64 totalSamples = 0;
+
+    static double sum(const juce::Array<double>& values)
+    {
+        return std::accumulate(values.begin(), values.end(), 0.0);
+    }
+};
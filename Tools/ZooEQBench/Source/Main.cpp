@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    ZooEQBench : processBlock micro-benchmarks.
+
+    ZooEQBench [--format=csv|json] [--output=<file>] [--seconds=<s>]
+               [--blocks=16,64,...] [--rates=44100,...] [--channels=1,2]
+               [--no-bypass-combinations] [--double]
+
+    Every combination of block size, sample rate, slope, bypass state and channel
+    count is rendered and reported as ns/sample, cycles/sample (x86 only) and the
+    p50 / p99 / max time of a single processBlock call.
+
+    ZooEQBench --stress [--format=csv|json] [--output=<file>] [--seconds=<s>]
+               [--channels=<n>] [--rate=<Hz>] [--max-block=<n>] [--no-concurrent-automation]
+
+    Every parameter automated every block, random block sizes : reports the block time
+    distribution, the worst block against its deadline and the number of allocations
+    made on the audio thread. Exits with 2 when processBlock allocated.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "ProcessorBenchmark.h"
+#include "StressBenchmark.h"
+
+static bool writeReport(const juce::ArgumentList& args, const juce::String& report)
+{
+    if ( ! args.containsOption("--output") )
+    {
+        std::cout << report;
+        return true;
+    }
+
+    auto file = args.getFileForOption("--output");
+
+    if ( file.replaceWithText(report) )
+        return true;
+
+    std::cerr << "Could not write " << file.getFullPathName() << std::endl;
+    return false;
+}
+
+static int runStressBenchmark(const juce::ArgumentList& args)
+{
+    StressOptions options;
+
+    if ( args.containsOption("--channels") )
+        options.numChannels = args.getValueForOption("--channels").getIntValue();
+
+    if ( args.containsOption("--rate") )
+        options.sampleRate = args.getValueForOption("--rate").getDoubleValue();
+
+    if ( args.containsOption("--max-block") )
+        options.maximumBlockSize = args.getValueForOption("--max-block").getIntValue();
+
+    if ( args.containsOption("--seconds") )
+        options.seconds = args.getValueForOption("--seconds").getDoubleValue();
+
+    options.concurrentAutomation = ! args.containsOption("--no-concurrent-automation");
+
+    StressBenchmark benchmark(options);
+    auto result = benchmark.run();
+
+    if ( result.numBlocks == 0 )
+    {
+        std::cerr << options.numChannels << " channels are not supported" << std::endl;
+        return 1;
+    }
+
+    auto report = args.getValueForOption("--format") == "json" ? toJSON(result) : toCSV(result);
+
+    if ( ! writeReport(args, report) )
+        return 1;
+
+    return result.isRealtimeSafe() ? 0 : 2;
+}
+
+static juce::StringArray getList(const juce::ArgumentList& args, const juce::String& option)
+{
+    return juce::StringArray::fromTokens(args.getValueForOption(option), ",", {});
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+
+    if ( args.containsOption("--help|-h") )
+    {
+        std::cout << "Usage : ZooEQBench [--format=csv|json] [--output=<file>] [--seconds=<s>]" << std::endl
+                  << "                   [--blocks=16,64,...] [--rates=44100,...] [--channels=1,2]" << std::endl
+                  << "                   [--no-bypass-combinations] [--double]" << std::endl
+                  << "       ZooEQBench --stress [--format=csv|json] [--output=<file>] [--seconds=<s>]" << std::endl
+                  << "                   [--channels=<n>] [--rate=<Hz>] [--max-block=<n>] [--no-concurrent-automation]" << std::endl;
+        return 0;
+    }
+
+    if ( args.containsOption("--stress") )
+        return runStressBenchmark(args);
+
+    BenchmarkOptions options;
+
+    if ( args.containsOption("--blocks") )
+    {
+        options.blockSizes.clear();
+        for ( auto& s : getList(args, "--blocks") )
+            options.blockSizes.add(s.getIntValue());
+    }
+
+    if ( args.containsOption("--rates") )
+    {
+        options.sampleRates.clear();
+        for ( auto& s : getList(args, "--rates") )
+            options.sampleRates.add(s.getDoubleValue());
+    }
+
+    if ( args.containsOption("--channels") )
+    {
+        options.channelCounts.clear();
+        for ( auto& s : getList(args, "--channels") )
+            options.channelCounts.add(s.getIntValue());
+    }
+
+    if ( args.containsOption("--seconds") )
+        options.secondsPerCase = args.getValueForOption("--seconds").getDoubleValue();
+
+    options.allBypassCombinations = ! args.containsOption("--no-bypass-combinations");
+    options.includeDoublePrecision = args.containsOption("--double");
+
+    ProcessorBenchmark benchmark(options);
+    auto cases = benchmark.makeCases();
+
+    juce::Array<BenchmarkResult> results;
+
+    for ( int i = 0; i < cases.size(); ++i )
+    {
+        results.add(benchmark.run(cases.getReference(i)));
+        std::cerr << "\r" << i + 1 << "/" << cases.size() << std::flush;
+    }
+
+    std::cerr << std::endl;
+
+    auto report = args.getValueForOption("--format") == "json" ? toJSON(results) : toCSV(results);
+
+    return writeReport(args, report) ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/*
+  ==============================================================================
+
+    ProcessorBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "ProcessorBenchmark.h"
+
+void setParameter(ZooEQAudioProcessor& processor, const juce::String& parameterID, float value)
+{
+    auto* param = processor.apvts.getParameter(parameterID);
+    jassert(param != nullptr);
+
+    param->setValueNotifyingHost(param->convertTo0to1(value));
+}
+
+bool prepareProcessor(ZooEQAudioProcessor& processor, int numChannels, double sampleRate, int blockSize, bool doublePrecision)
+{
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+    layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+
+    if ( ! processor.setBusesLayout(layout) )
+        return false;
+
+    processor.setProcessingPrecision(doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                     : juce::AudioProcessor::singlePrecision);
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+    return true;
+}
+
+//==============================================================================
+ProcessorBenchmark::ProcessorBenchmark(const BenchmarkOptions& o) : options(o)
+{
+    //A few seconds of noise at the largest block size, the blocks read it in turn
+    noise.setSize(2, 1 << 16);
+    juce::Random random(0x2ee);
+
+    for ( int ch = 0; ch < noise.getNumChannels(); ++ch )
+        for ( int i = 0; i < noise.getNumSamples(); ++i )
+            noise.setSample(ch, i, random.nextFloat() * 2.f - 1.f);
+
+    //The same curve for every case, only the slopes and bypasses move
+    setParameter(processor, "LowCut Freq", 80.f);
+    setParameter(processor, "HighCut Freq", 12000.f);
+    setParameter(processor, "Peak Freq", 1000.f);
+    setParameter(processor, "Peak Gain", 6.f);
+    setParameter(processor, "Peak Quality", 1.f);
+}
+
+juce::Array<BenchmarkCase> ProcessorBenchmark::makeCases() const
+{
+    juce::Array<BenchmarkCase> cases;
+    const int numBypassCombinations = options.allBypassCombinations ? 8 : 1;
+
+    juce::Array<bool> precisions { false };
+
+    if ( options.includeDoublePrecision )
+        precisions.add(true);
+
+    for ( auto doublePrecision : precisions )
+    for ( auto numChannels : options.channelCounts )
+    for ( auto sampleRate : options.sampleRates )
+    for ( auto blockSize : options.blockSizes )
+    for ( auto slope : options.slopes )
+    for ( int bypass = 0; bypass < numBypassCombinations; ++bypass )
+    {
+        BenchmarkCase c;
+        c.numChannels = numChannels;
+        c.sampleRate = sampleRate;
+        c.blockSize = blockSize;
+        c.lowCutSlope = c.highCutSlope = slope;
+        c.lowCutBypassed = (bypass & 1) != 0;
+        c.peakBypassed = (bypass & 2) != 0;
+        c.highCutBypassed = (bypass & 4) != 0;
+        c.doublePrecision = doublePrecision;
+        cases.add(c);
+    }
+
+    return cases;
+}
+
+BenchmarkResult ProcessorBenchmark::run(const BenchmarkCase& benchmarkCase)
+{
+    BenchmarkResult result;
+    result.config = benchmarkCase;
+
+    setParameter(processor, "LowCut Slope", (float)benchmarkCase.lowCutSlope);
+    setParameter(processor, "HighCut Slope", (float)benchmarkCase.highCutSlope);
+    setParameter(processor, "LowCut Bypassed", benchmarkCase.lowCutBypassed ? 1.f : 0.f);
+    setParameter(processor, "Peak Bypassed", benchmarkCase.peakBypassed ? 1.f : 0.f);
+    setParameter(processor, "HighCut Bypassed", benchmarkCase.highCutBypassed ? 1.f : 0.f);
+
+    //prepareToPlay designs the filters right away : no glide at the start of the run
+    if ( ! prepareProcessor(processor, benchmarkCase.numChannels, benchmarkCase.sampleRate,
+                            benchmarkCase.blockSize, benchmarkCase.doublePrecision) )
+        return result;
+
+    auto numBlocks = juce::jmax(32, (int)std::ceil(options.secondsPerCase * benchmarkCase.sampleRate / benchmarkCase.blockSize));
+    auto numWarmUpBlocks = juce::jmax(8, numBlocks / 10);
+
+    BlockStatistics statistics;
+    statistics.prepare(numBlocks);
+
+    if ( benchmarkCase.doublePrecision )
+    {
+        render<double>(benchmarkCase, statistics, numWarmUpBlocks, false);
+        render<double>(benchmarkCase, statistics, numBlocks, true);
+    }
+    else
+    {
+        render<float>(benchmarkCase, statistics, numWarmUpBlocks, false);
+        render<float>(benchmarkCase, statistics, numBlocks, true);
+    }
+
+    processor.releaseResources();
+
+    result.numBlocks = statistics.getNumBlocks();
+    result.nanosecondsPerSample = statistics.getNanosecondsPerSample();
+    result.cyclesPerSample = statistics.getCyclesPerSample();
+    result.p50Microseconds = statistics.getPercentileMicroseconds(0.5);
+    result.p99Microseconds = statistics.getPercentileMicroseconds(0.99);
+    result.maxMicroseconds = statistics.getMaxMicroseconds();
+    return result;
+}
+
+template<typename SampleType>
+void ProcessorBenchmark::render(const BenchmarkCase& benchmarkCase, BlockStatistics& statistics, int numBlocks, bool measure)
+{
+    juce::AudioBuffer<SampleType> buffer(benchmarkCase.numChannels, benchmarkCase.blockSize);
+    juce::MidiBuffer midi;
+    BlockTimer timer;
+
+    int readPosition = 0;
+
+    for ( int block = 0; block < numBlocks; ++block )
+    {
+        if ( readPosition + benchmarkCase.blockSize > noise.getNumSamples() )
+            readPosition = 0;
+
+        for ( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+        {
+            auto* source = noise.getReadPointer(ch % noise.getNumChannels(), readPosition);
+            auto* dest = buffer.getWritePointer(ch);
+
+            for ( int i = 0; i < benchmarkCase.blockSize; ++i )
+                dest[i] = (SampleType)source[i];
+        }
+
+        readPosition += benchmarkCase.blockSize;
+
+        timer.start();
+        processor.processBlock(buffer, midi);
+        timer.stop();
+
+        if ( measure )
+            statistics.record(timer, benchmarkCase.blockSize);
+    }
+}
+
+//==============================================================================
+namespace
+{
+juce::String getSlopeName(Slope slope)
+{
+    return juce::String(12 * (slope + 1)) + "dB";
+}
+}
+
+juce::String toCSV(const juce::Array<BenchmarkResult>& results)
+{
+    juce::String csv;
+    csv << "channels,precision,sampleRate,blockSize,lowCutSlope,highCutSlope,"
+           "lowCutBypassed,peakBypassed,highCutBypassed,blocks,nsPerSample,cyclesPerSample,p50us,p99us,maxus\n";
+
+    for ( auto& r : results )
+    {
+        auto& c = r.config;
+        csv << c.numChannels << "," << (c.doublePrecision ? "double" : "float") << ","
+            << c.sampleRate << "," << c.blockSize << ","
+            << getSlopeName(c.lowCutSlope) << "," << getSlopeName(c.highCutSlope) << ","
+            << (int)c.lowCutBypassed << "," << (int)c.peakBypassed << "," << (int)c.highCutBypassed << ","
+            << r.numBlocks << ","
+            << juce::String(r.nanosecondsPerSample, 3) << ","
+            << (BlockTimer::hasCycles() ? juce::String(r.cyclesPerSample, 3) : juce::String()) << ","
+            << juce::String(r.p50Microseconds, 3) << ","
+            << juce::String(r.p99Microseconds, 3) << ","
+            << juce::String(r.maxMicroseconds, 3) << "\n";
+    }
+
+    return csv;
+}
+
+juce::String toJSON(const juce::Array<BenchmarkResult>& results)
+{
+    juce::Array<juce::var> cases;
+
+    for ( auto& r : results )
+    {
+        auto& c = r.config;
+        auto* o = new juce::DynamicObject();
+
+        o->setProperty("channels", c.numChannels);
+        o->setProperty("precision", c.doublePrecision ? "double" : "float");
+        o->setProperty("sampleRate", c.sampleRate);
+        o->setProperty("blockSize", c.blockSize);
+        o->setProperty("lowCutSlope", getSlopeName(c.lowCutSlope));
+        o->setProperty("highCutSlope", getSlopeName(c.highCutSlope));
+        o->setProperty("lowCutBypassed", c.lowCutBypassed);
+        o->setProperty("peakBypassed", c.peakBypassed);
+        o->setProperty("highCutBypassed", c.highCutBypassed);
+        o->setProperty("blocks", r.numBlocks);
+        o->setProperty("nsPerSample", r.nanosecondsPerSample);
+
+        if ( BlockTimer::hasCycles() )
+            o->setProperty("cyclesPerSample", r.cyclesPerSample);
+
+        o->setProperty("p50us", r.p50Microseconds);
+        o->setProperty("p99us", r.p99Microseconds);
+        o->setProperty("maxus", r.maxMicroseconds);
+
+        cases.add(juce::var(o));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("version", benchmarkFormatVersion);
+    root->setProperty("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty("os", juce::SystemStats::getOperatingSystemName());
+    root->setProperty("cases", cases);
+
+    return juce::JSON::toString(juce::var(root));
+}
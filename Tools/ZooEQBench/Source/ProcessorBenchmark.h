@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    ProcessorBenchmark.h
+    Drives ZooEQAudioProcessor headlessly over a matrix of configurations.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "BlockTimer.h"
+
+//Sets a parameter in its own units (Hz, dB, slope index, 0/1)
+void setParameter(ZooEQAudioProcessor& processor, const juce::String& parameterID, float value);
+
+//Configures the buses and calls prepareToPlay, returns false if the layout is refused
+bool prepareProcessor(ZooEQAudioProcessor& processor, int numChannels, double sampleRate, int blockSize, bool doublePrecision);
+
+struct BenchmarkCase
+{
+    int numChannels = 2;
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
+    bool lowCutBypassed = false, peakBypassed = false, highCutBypassed = false;
+    bool doublePrecision = false;
+};
+
+struct BenchmarkResult
+{
+    BenchmarkCase config;
+    int numBlocks = 0;
+    double nanosecondsPerSample = 0, cyclesPerSample = 0;
+    double p50Microseconds = 0, p99Microseconds = 0, maxMicroseconds = 0;
+};
+
+struct BenchmarkOptions
+{
+    juce::Array<int> blockSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    juce::Array<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+    juce::Array<int> channelCounts { 1, 2 };
+    juce::Array<Slope> slopes { Slope::Slope_12, Slope::Slope_24, Slope::Slope_36, Slope::Slope_48 };
+    bool allBypassCombinations = true;
+    bool includeDoublePrecision = false;
+
+    //Audio rendered per case, after the warm up
+    double secondsPerCase = 1.0;
+};
+
+/**
+    Every case renders secondsPerCase of white noise block by block and times each
+    processBlock call on its own. The input is refreshed outside of the timed region,
+    so only the processor is measured.
+ */
+struct ProcessorBenchmark
+{
+    explicit ProcessorBenchmark(const BenchmarkOptions& options);
+
+    juce::Array<BenchmarkCase> makeCases() const;
+
+    BenchmarkResult run(const BenchmarkCase& benchmarkCase);
+
+private:
+    BenchmarkOptions options;
+    ZooEQAudioProcessor processor;
+    juce::AudioBuffer<float> noise;
+
+    template<typename SampleType>
+    void render(const BenchmarkCase& benchmarkCase, BlockStatistics& statistics, int numBlocks, bool measure);
+};
+
+//Bumped whenever the columns / keys of the reports change
+constexpr int benchmarkFormatVersion = 1;
+
+juce::String toCSV(const juce::Array<BenchmarkResult>& results);
+juce::String toJSON(const juce::Array<BenchmarkResult>& results);
@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+    StressBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "StressBenchmark.h"
+#include "AllocationCounter.h"
+
+struct StressBenchmark::AutomationThread : juce::Thread
+{
+    AutomationThread(StressBenchmark& b, juce::int64 seed) :
+    juce::Thread("ZooEQ Stress Automation"),
+    benchmark(b),
+    random(seed)
+    { }
+
+    void run() override
+    {
+        while ( ! threadShouldExit() )
+        {
+            numChanges += benchmark.randomiseParameters(random);
+            juce::Thread::yield();
+        }
+    }
+
+    StressBenchmark& benchmark;
+    juce::Random random;
+    std::atomic<juce::int64> numChanges { 0 };
+};
+
+//==============================================================================
+StressBenchmark::StressBenchmark(const StressOptions& o) : options(o)
+{
+    options.maximumBlockSize = juce::jmax(1, options.maximumBlockSize);
+
+    auto& apvts = processor.apvts;
+
+    continuousParameters = { apvts.getParameter("LowCut Freq"),
+                             apvts.getParameter("HighCut Freq"),
+                             apvts.getParameter("Peak Freq"),
+                             apvts.getParameter("Peak Gain"),
+                             apvts.getParameter("Peak Quality") };
+
+    discreteParameters = { apvts.getParameter("LowCut Slope"),
+                           apvts.getParameter("HighCut Slope"),
+                           apvts.getParameter("LowCut Bypassed"),
+                           apvts.getParameter("Peak Bypassed"),
+                           apvts.getParameter("HighCut Bypassed") };
+}
+
+juce::int64 StressBenchmark::randomiseParameters(juce::Random& random)
+{
+    juce::int64 numChanges = 0;
+
+    for ( auto* param : continuousParameters )
+    {
+        param->setValueNotifyingHost(random.nextFloat());
+        ++numChanges;
+    }
+
+    //Slopes and bypasses move less often, but still several times per second
+    for ( auto* param : discreteParameters )
+    {
+        if ( random.nextInt(8) == 0 )
+        {
+            auto numSteps = juce::jmax(2, param->getNumSteps());
+            param->setValueNotifyingHost((float)random.nextInt(numSteps) / (float)(numSteps - 1));
+            ++numChanges;
+        }
+    }
+
+    return numChanges;
+}
+
+StressResult StressBenchmark::run()
+{
+    StressResult result;
+    result.options = options;
+    result.countsMalloc = AllocationCounter::countsMalloc();
+
+    juce::Random random(options.seed);
+
+    //The block sizes are drawn up front so that the statistics can be preallocated
+    juce::Array<int> blockSizes;
+    const auto totalSamples = (juce::int64)(options.seconds * options.sampleRate);
+
+    for ( juce::int64 n = 0; n < totalSamples; n += blockSizes.getLast() )
+        blockSizes.add(1 + random.nextInt(options.maximumBlockSize));
+
+    if ( ! prepareProcessor(processor, options.numChannels, options.sampleRate, options.maximumBlockSize, false) )
+        return result;
+
+    juce::AudioBuffer<float> buffer(options.numChannels, options.maximumBlockSize);
+    juce::MidiBuffer midi;
+    BlockTimer timer;
+    BlockStatistics statistics;
+    statistics.prepare(blockSizes.size());
+
+    std::unique_ptr<AutomationThread> automationThread;
+
+    if ( options.concurrentAutomation )
+    {
+        automationThread = std::make_unique<AutomationThread>(*this, options.seed + 1);
+        automationThread->startThread();
+    }
+
+    for ( auto blockSize : blockSizes )
+    {
+        buffer.setSize(options.numChannels, blockSize, false, false, true);
+
+        for ( int ch = 0; ch < options.numChannels; ++ch )
+        {
+            auto* data = buffer.getWritePointer(ch);
+
+            for ( int i = 0; i < blockSize; ++i )
+                data[i] = random.nextFloat() * 2.f - 1.f;
+        }
+
+        // === Host automation, audio thread side === //
+        {
+            AllocationCounter::Scope allocations;
+            result.numParameterChanges += randomiseParameters(random);
+            result.automationAllocations += allocations.getNumAllocations();
+        }
+
+        // === processBlock === //
+        {
+            AllocationCounter::Scope allocations;
+
+            timer.start();
+            processor.processBlock(buffer, midi);
+            timer.stop();
+
+            result.processBlockAllocations += allocations.getNumAllocations();
+        }
+
+        statistics.record(timer, blockSize);
+
+        auto load = timer.getLastNanoseconds() / (blockSize / options.sampleRate * 1.0e9);
+
+        if ( load > result.worstLoad )
+        {
+            result.worstLoad = load;
+            result.worstBlockSize = blockSize;
+        }
+    }
+
+    if ( automationThread != nullptr )
+    {
+        automationThread->stopThread(1000);
+        result.numParameterChanges += automationThread->numChanges;
+    }
+
+    processor.releaseResources();
+
+    result.numBlocks = statistics.getNumBlocks();
+    result.p50Microseconds = statistics.getPercentileMicroseconds(0.5);
+    result.p99Microseconds = statistics.getPercentileMicroseconds(0.99);
+    result.p999Microseconds = statistics.getPercentileMicroseconds(0.999);
+    result.maxMicroseconds = statistics.getMaxMicroseconds();
+    return result;
+}
+
+//==============================================================================
+juce::String toCSV(const StressResult& r)
+{
+    juce::String csv;
+    csv << "channels,sampleRate,maxBlockSize,blocks,parameterChanges,p50us,p99us,p999us,maxus,"
+           "worstLoad,worstBlockSize,processBlockAllocations,automationAllocations,countsMalloc\n";
+
+    csv << r.options.numChannels << "," << r.options.sampleRate << "," << r.options.maximumBlockSize << ","
+        << r.numBlocks << "," << r.numParameterChanges << ","
+        << juce::String(r.p50Microseconds, 3) << ","
+        << juce::String(r.p99Microseconds, 3) << ","
+        << juce::String(r.p999Microseconds, 3) << ","
+        << juce::String(r.maxMicroseconds, 3) << ","
+        << juce::String(r.worstLoad, 4) << "," << r.worstBlockSize << ","
+        << r.processBlockAllocations << "," << r.automationAllocations << ","
+        << (int)r.countsMalloc << "\n";
+
+    return csv;
+}
+
+juce::String toJSON(const StressResult& r)
+{
+    auto* o = new juce::DynamicObject();
+
+    o->setProperty("version", benchmarkFormatVersion);
+    o->setProperty("cpu", juce::SystemStats::getCpuModel());
+    o->setProperty("os", juce::SystemStats::getOperatingSystemName());
+    o->setProperty("channels", r.options.numChannels);
+    o->setProperty("sampleRate", r.options.sampleRate);
+    o->setProperty("maxBlockSize", r.options.maximumBlockSize);
+    o->setProperty("concurrentAutomation", r.options.concurrentAutomation);
+    o->setProperty("blocks", r.numBlocks);
+    o->setProperty("parameterChanges", r.numParameterChanges);
+    o->setProperty("p50us", r.p50Microseconds);
+    o->setProperty("p99us", r.p99Microseconds);
+    o->setProperty("p999us", r.p999Microseconds);
+    o->setProperty("maxus", r.maxMicroseconds);
+    o->setProperty("worstLoad", r.worstLoad);
+    o->setProperty("worstBlockSize", r.worstBlockSize);
+    o->setProperty("processBlockAllocations", r.processBlockAllocations);
+    o->setProperty("automationAllocations", r.automationAllocations);
+    o->setProperty("countsMalloc", r.countsMalloc);
+
+    return juce::JSON::toString(juce::var(o));
+}
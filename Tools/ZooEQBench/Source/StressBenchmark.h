@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    StressBenchmark.h
+    Worst case block times and audio thread allocations under heavy automation.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ProcessorBenchmark.h"
+
+struct StressOptions
+{
+    int numChannels = 2;
+    double sampleRate = 48000.0;
+
+    //Announced to prepareToPlay, the blocks then get any size between 1 and this
+    int maximumBlockSize = 1024;
+
+    double seconds = 60.0;
+
+    //A second thread also moves every parameter as fast as it can, like a GUI or a host's automation thread
+    bool concurrentAutomation = true;
+
+    juce::int64 seed = 0x2ee;
+};
+
+struct StressResult
+{
+    StressOptions options;
+    int numBlocks = 0;
+    juce::int64 numParameterChanges = 0;
+
+    double p50Microseconds = 0, p99Microseconds = 0, p999Microseconds = 0, maxMicroseconds = 0;
+
+    //Longest block time relative to the duration of the audio it produced (1 = the deadline)
+    double worstLoad = 0;
+    int worstBlockSize = 0;
+
+    juce::int64 processBlockAllocations = 0;
+    juce::int64 automationAllocations = 0;
+    bool countsMalloc = false;
+
+    bool isRealtimeSafe() const { return processBlockAllocations == 0; }
+};
+
+/**
+    Every block, on the audio thread :
+    - all the continuous parameters jump to new random values,
+    - slopes and bypasses are toggled at random,
+    - the block size changes at random,
+    then processBlock is timed on its own. Allocations are counted separately for the
+    parameter changes and for processBlock, so a regression shows up in the right column.
+ */
+struct StressBenchmark
+{
+    explicit StressBenchmark(const StressOptions& options);
+
+    StressResult run();
+
+private:
+    struct AutomationThread;
+
+    StressOptions options;
+    ZooEQAudioProcessor processor;
+
+    //Looked up once, so that moving them doesn't involve the APVTS's ID map
+    std::array<juce::RangedAudioParameter*, 5> continuousParameters;
+    std::array<juce::RangedAudioParameter*, 5> discreteParameters;
+
+    juce::int64 randomiseParameters(juce::Random& random);
+};
+
+juce::String toCSV(const StressResult& result);
+juce::String toJSON(const StressResult& result);
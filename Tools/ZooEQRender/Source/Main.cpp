@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    ZooEQRender : applies ZooEQ settings to audio files, no DAW needed.
+
+    ZooEQRender [--state <file>] [--param "<ID>=<value>"]... [--output <dir>]
+                [--jobs <n>] [--block <samples>] <files or directories>...
+
+    --state   binary state written by the plugin (getStateInformation)
+    --param   parameter ID and value in its own units, e.g. --param "LowCut Freq=40"
+              or --param "LowCut Slope=3" (slope index), --param "Peak Bypassed=1"
+    --output  where the rendered files go (default : ./ZooEQRender), same names and formats
+    --jobs    number of worker threads, one processor each (default : number of CPUs)
+    --block   processing block size (default : 4096)
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "OfflineRenderer.h"
+
+static void printUsage()
+{
+    std::cout << "Usage : ZooEQRender [--state <file>] [--param \"<ID>=<value>\"]... [--output <dir>]" << std::endl
+              << "                    [--jobs <n>] [--block <samples>] <files or directories>..." << std::endl;
+}
+
+int main (int argc, char* argv[])
+{
+    //The processor's AudioProcessorValueTreeState runs a juce::Timer, which needs a MessageManager :
+    //this initialiser is what creates one in a console app. No window or display connection is opened.
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+
+    RenderSettings settings;
+    settings.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile("ZooEQRender");
+
+    juce::Array<juce::File> files;
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    auto isAudioFile = [&formats](const juce::File& f) { return formats.findFormatForFileExtension(f.getFileExtension()) != nullptr; };
+
+    for ( int i = 0; i < args.size(); ++i )
+    {
+        auto arg = args[i];
+        auto hasValue = i + 1 < args.size();
+
+        if ( arg.isShortOption('h') || arg.isLongOption("help") )
+        {
+            printUsage();
+            return 0;
+        }
+
+        if ( arg.isLongOption("state") && hasValue )
+        {
+            auto stateFile = args[++i].resolveAsExistingFile();
+
+            if ( ! stateFile.loadFileAsData(settings.state) )
+            {
+                std::cerr << "Could not read " << stateFile.getFullPathName() << std::endl;
+                return 1;
+            }
+        }
+        else if ( arg.isLongOption("param") && hasValue )
+        {
+            auto assignment = args[++i].text;
+
+            if ( ! assignment.containsChar('=') )
+            {
+                std::cerr << "Expected \"<ID>=<value>\", got " << assignment << std::endl;
+                return 1;
+            }
+
+            settings.parameterValues.set(assignment.upToLastOccurrenceOf("=", false, false).trim(),
+                                         assignment.fromLastOccurrenceOf("=", false, false).trim());
+        }
+        else if ( arg.isLongOption("output") && hasValue )
+        {
+            settings.outputDirectory = args[++i].resolveAsFile();
+        }
+        else if ( arg.isLongOption("jobs") && hasValue )
+        {
+            settings.numWorkers = args[++i].text.getIntValue();
+        }
+        else if ( arg.isLongOption("block") && hasValue )
+        {
+            settings.blockSize = args[++i].text.getIntValue();
+        }
+        else if ( arg.isOption() )
+        {
+            std::cerr << "Unknown option " << arg.text << std::endl;
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            auto f = arg.resolveAsFile();
+
+            if ( f.isDirectory() )
+            {
+                for ( auto& child : f.findChildFiles(juce::File::findFiles, false) )
+                    if ( isAudioFile(child) )
+                        files.add(child);
+            }
+            else if ( f.existsAsFile() && isAudioFile(f) )
+            {
+                files.add(f);
+            }
+            else
+            {
+                std::cerr << "Skipping " << f.getFullPathName() << std::endl;
+            }
+        }
+    }
+
+    if ( files.isEmpty() )
+    {
+        printUsage();
+        return 1;
+    }
+
+    //No point in more workers than files
+    settings.numWorkers = juce::jlimit(1, files.size(), settings.numWorkers);
+
+    OfflineRenderer renderer(settings);
+    auto error = renderer.prepare();
+
+    if ( error.isNotEmpty() )
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+    double totalAudioSeconds = 0;
+    int numFailed = 0;
+
+    //Called from the workers, one at a time
+    renderer.render(files, [&](const RenderResult& result)
+    {
+        if ( result.wasSuccessful() )
+        {
+            totalAudioSeconds += result.numSamples / result.sampleRate;
+            std::cout << result.output.getFullPathName() << " : "
+                      << juce::String(result.getRealtimeFactor(), 1) << "x realtime" << std::endl;
+        }
+        else
+        {
+            ++numFailed;
+            std::cerr << result.input.getFullPathName() << " : " << result.error << std::endl;
+        }
+    });
+
+    auto elapsed = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+    std::cout << files.size() - numFailed << "/" << files.size() << " files rendered in "
+              << juce::String(elapsed, 2) << "s ("
+              << juce::String(elapsed > 0 ? totalAudioSeconds / elapsed : 0.0, 1) << "x realtime overall)" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
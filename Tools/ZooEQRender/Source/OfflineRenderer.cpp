@@ -0,0 +1,309 @@
+/*
+  ==============================================================================
+
+    OfflineRenderer.cpp
+
+  ==============================================================================
+*/
+
+#include "OfflineRenderer.h"
+
+namespace
+{
+//Hands out the samples of an input file block by block without ever holding the whole file
+struct StreamingInput
+{
+    juce::String open(juce::AudioFormatManager& formats, const juce::File& file, juce::TimeSliceThread& ioThread, int blockSize)
+    {
+        auto* format = formats.findFormatForFileExtension(file.getFileExtension());
+
+        if ( format == nullptr )
+            return "Unsupported file format";
+
+        //WAV / AIFF : the OS pages a sliding window of the file in, no copy through our own buffers
+        mapped.reset(format->createMemoryMappedReader(file));
+
+        if ( mapped != nullptr )
+        {
+            reader = mapped.get();
+            windowLength = (juce::int64)blockSize * 64;
+            return {};
+        }
+
+        //Other formats are decoded ahead of the processing on the I/O thread
+        auto* source = formats.createReaderFor(file);
+
+        if ( source == nullptr )
+            return "Could not open the file";
+
+        buffered = std::make_unique<juce::BufferingAudioReader>(source, ioThread, blockSize * 16);
+        buffered->setReadTimeout(-1); //Offline : wait for the data instead of returning silence
+        reader = buffered.get();
+        return {};
+    }
+
+    bool read(juce::AudioBuffer<float>& buffer, juce::int64 startSample, int numSamples)
+    {
+        if ( mapped != nullptr )
+        {
+            juce::Range<juce::int64> needed(startSample, startSample + numSamples);
+
+            if ( ! mapped->getMappedSection().contains(needed) )
+            {
+                auto end = juce::jmin(reader->lengthInSamples, startSample + juce::jmax(windowLength, (juce::int64)numSamples));
+
+                if ( ! mapped->mapSectionOfFile({ startSample, end }) )
+                    return false;
+            }
+        }
+
+        reader->read(&buffer, 0, numSamples, startSample, true, true);
+        return true;
+    }
+
+    juce::AudioFormatReader* reader = nullptr;
+
+private:
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped;
+    std::unique_ptr<juce::BufferingAudioReader> buffered;
+    juce::int64 windowLength = 0;
+};
+}
+
+//==============================================================================
+struct OfflineRenderer::Worker : juce::ThreadPoolJob
+{
+    Worker(OfflineRenderer& r,
+           ZooEQAudioProcessor& p,
+           const juce::Array<juce::File>& f,
+           std::atomic<int>& next,
+           juce::Array<RenderResult>& res,
+           juce::CriticalSection& lock,
+           std::function<void(const RenderResult&)>& callback) :
+    juce::ThreadPoolJob("ZooEQ Render Worker"),
+    renderer(r), processor(p), files(f), nextFile(next), results(res), resultsLock(lock), onFileFinished(callback)
+    { }
+
+    JobStatus runJob() override
+    {
+        ioThread.startThread();
+
+        //Each worker keeps its own processor and I/O thread, and pulls the next file until none are left
+        for ( auto index = nextFile++; index < files.size() && ! shouldExit(); index = nextFile++ )
+        {
+            auto result = renderer.renderFile(processor, files.getReference(index), ioThread);
+
+            const juce::ScopedLock sl(resultsLock);
+            results.getReference(index) = result;
+
+            if ( onFileFinished )
+                onFileFinished(result);
+        }
+
+        ioThread.stopThread(2000);
+        return jobHasFinished;
+    }
+
+private:
+    OfflineRenderer& renderer;
+    ZooEQAudioProcessor& processor;
+    const juce::Array<juce::File>& files;
+    std::atomic<int>& nextFile;
+    juce::Array<RenderResult>& results;
+    juce::CriticalSection& resultsLock;
+    std::function<void(const RenderResult&)>& onFileFinished;
+    juce::TimeSliceThread ioThread { "ZooEQ Render I/O" };
+};
+
+//==============================================================================
+OfflineRenderer::OfflineRenderer(const RenderSettings& s) : settings(s)
+{
+    settings.blockSize = juce::jmax(16, settings.blockSize);
+    settings.numWorkers = juce::jmax(1, settings.numWorkers);
+
+    formatManager.registerBasicFormats();
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+    processors.clear();
+}
+
+juce::String OfflineRenderer::prepare()
+{
+    if ( ! settings.outputDirectory.isDirectory() && ! settings.outputDirectory.createDirectory() )
+        return "Could not create the output directory " + settings.outputDirectory.getFullPathName();
+
+    processors.clear();
+
+    for ( int i = 0; i < settings.numWorkers; ++i )
+    {
+        auto* processor = processors.add(new ZooEQAudioProcessor());
+        auto error = applySettings(*processor);
+
+        if ( error.isNotEmpty() )
+            return error;
+
+        processor->setNonRealtime(true);
+    }
+
+    return {};
+}
+
+juce::String OfflineRenderer::applySettings(ZooEQAudioProcessor& processor) const
+{
+    if ( settings.state.getSize() > 0 )
+    {
+        if ( ! juce::ValueTree::readFromData(settings.state.getData(), settings.state.getSize()).isValid() )
+            return "The state file is not a ZooEQ state";
+
+        processor.setStateInformation(settings.state.getData(), (int)settings.state.getSize());
+    }
+
+    for ( auto& parameterID : settings.parameterValues.getAllKeys() )
+    {
+        auto* param = processor.apvts.getParameter(parameterID);
+
+        if ( param == nullptr )
+            return "Unknown parameter : " + parameterID;
+
+        auto value = settings.parameterValues[parameterID].getFloatValue();
+        param->setValueNotifyingHost(param->convertTo0to1(value));
+    }
+
+    return {};
+}
+
+juce::Array<RenderResult> OfflineRenderer::render(const juce::Array<juce::File>& files,
+                                                  std::function<void(const RenderResult&)> onFileFinished)
+{
+    jassert(processors.size() > 0); //prepare() first !
+
+    juce::Array<RenderResult> results;
+    results.resize(files.size());
+
+    std::atomic<int> nextFile { 0 };
+    juce::CriticalSection resultsLock;
+
+    juce::ThreadPool pool(processors.size());
+    juce::OwnedArray<Worker> workers;
+
+    for ( auto* processor : processors )
+    {
+        auto* worker = workers.add(new Worker(*this, *processor, files, nextFile, results, resultsLock, onFileFinished));
+        pool.addJob(worker, false);
+    }
+
+    for ( auto* worker : workers )
+        pool.waitForJobToFinish(worker, -1);
+
+    return results;
+}
+
+RenderResult OfflineRenderer::renderFile(ZooEQAudioProcessor& processor, const juce::File& inputFile, juce::TimeSliceThread& ioThread)
+{
+    RenderResult result;
+    result.input = inputFile;
+    result.output = settings.outputDirectory.getChildFile(inputFile.getFileName());
+
+    if ( result.output == inputFile )
+    {
+        result.error = "The output would overwrite the input";
+        return result;
+    }
+
+    // === Input === //
+    StreamingInput input;
+    result.error = input.open(formatManager, inputFile, ioThread, settings.blockSize);
+
+    if ( result.error.isNotEmpty() )
+        return result;
+
+    auto& reader = *input.reader;
+    const auto numChannels = (int)reader.numChannels;
+    result.sampleRate = reader.sampleRate;
+    result.numSamples = reader.lengthInSamples;
+
+    // === Processor === //
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+    layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+
+    if ( ! processor.setBusesLayout(layout) )
+    {
+        result.error = juce::String(numChannels) + " channels are not supported";
+        return result;
+    }
+
+    // === Output === //
+    auto* outputFormat = formatManager.findFormatForFileExtension(result.output.getFileExtension());
+    auto bitDepths = outputFormat->getPossibleBitDepths();
+    auto bitDepth = bitDepths.contains((int)reader.bitsPerSample) ? (int)reader.bitsPerSample : bitDepths.getLast();
+
+    result.output.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> stream(result.output.createOutputStream());
+
+    if ( stream == nullptr )
+    {
+        result.error = "Could not create " + result.output.getFullPathName();
+        return result;
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> writer(outputFormat->createWriterFor(stream.get(),
+                                                                                  reader.sampleRate,
+                                                                                  (unsigned int)numChannels,
+                                                                                  bitDepth,
+                                                                                  reader.metadataValues,
+                                                                                  0));
+
+    if ( writer == nullptr )
+    {
+        stream.reset();
+        result.output.deleteFile();
+        result.error = "Could not write this channel count / bit depth";
+        return result;
+    }
+
+    stream.release(); //Now owned by the writer
+
+    processor.setRateAndBufferSizeDetails(reader.sampleRate, settings.blockSize);
+    processor.prepareToPlay(reader.sampleRate, settings.blockSize);
+
+    // === Render === //
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    {
+        //Flushes the remaining blocks to disk when leaving this scope
+        juce::AudioFormatWriter::ThreadedWriter output(writer.release(), ioThread, settings.blockSize * 16);
+
+        juce::AudioBuffer<float> buffer(numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+
+        for ( juce::int64 start = 0; start < result.numSamples; start += buffer.getNumSamples() )
+        {
+            auto numSamples = (int)juce::jmin((juce::int64)settings.blockSize, result.numSamples - start);
+            buffer.setSize(numChannels, numSamples, false, false, true);
+
+            if ( ! input.read(buffer, start, numSamples) )
+            {
+                result.error = "Read error at sample " + juce::String(start);
+                break;
+            }
+
+            processor.processBlock(buffer, midi);
+            midi.clear();
+
+            //The writer's FIFO is full : the disk is the bottleneck, let it catch up
+            while ( ! output.write(buffer.getArrayOfReadPointers(), numSamples) )
+                juce::Thread::sleep(1);
+        }
+    }
+
+    result.seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    processor.releaseResources();
+
+    if ( ! result.wasSuccessful() )
+        result.output.deleteFile();
+
+    return result;
+}
@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    OfflineRenderer.h
+    Streams audio files through ZooEQAudioProcessor without a host, one processor
+    per worker thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+struct RenderSettings
+{
+    //Blob written by ZooEQAudioProcessor::getStateInformation, applied first when not empty
+    juce::MemoryBlock state;
+
+    //Parameter ID -> value in the parameter's own units (Hz, dB, slope index, 0/1), applied after the state
+    juce::StringPairArray parameterValues;
+
+    juce::File outputDirectory;
+    int blockSize = 4096;
+    int numWorkers = juce::SystemStats::getNumCpus();
+};
+
+struct RenderResult
+{
+    juce::File input, output;
+    juce::String error;
+    juce::int64 numSamples = 0;
+    double sampleRate = 0;
+    double seconds = 0;
+
+    bool wasSuccessful() const { return error.isEmpty(); }
+    double getRealtimeFactor() const { return seconds > 0 ? (numSamples / sampleRate) / seconds : 0; }
+};
+
+/**
+    Renders a batch of WAV / AIFF / FLAC files with the same ZooEQ settings.
+
+    Memory stays constant whatever the file length : inputs are read through memory mapped
+    windows when the format allows it (WAV, AIFF), through a BufferingAudioReader otherwise,
+    and outputs go through a ThreadedWriter, so disk I/O overlaps the processing in both
+    directions. Reading, processing and writing all happen block by block.
+
+    The processors are created and configured on the calling thread (which must be the
+    message thread), the files are then shared between numWorkers jobs of a ThreadPool.
+    Each job has its own I/O thread, so the workers never queue behind each other's disk
+    accesses.
+ */
+struct OfflineRenderer
+{
+    OfflineRenderer(const RenderSettings& settings);
+    ~OfflineRenderer();
+
+    //Returns an empty string or the reason why the settings could not be applied
+    juce::String prepare();
+
+    //Blocks until every file has been rendered, results are in the same order as the files
+    juce::Array<RenderResult> render(const juce::Array<juce::File>& files,
+                                     std::function<void(const RenderResult&)> onFileFinished = {});
+
+private:
+    struct Worker;
+
+    RenderSettings settings;
+    juce::AudioFormatManager formatManager;
+    juce::OwnedArray<ZooEQAudioProcessor> processors;
+
+    juce::String applySettings(ZooEQAudioProcessor& processor) const;
+    RenderResult renderFile(ZooEQAudioProcessor& processor, const juce::File& input, juce::TimeSliceThread& ioThread);
+
+    JUCE_DECLARE_NON_COPYABLE(OfflineRenderer)
+};